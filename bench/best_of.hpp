@@ -0,0 +1,37 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <type_traits>
+#include <utility>
+
+
+// timing shared by the bench drivers, linked against compiled json kernels
+
+// what every driver takes on the command line, [n] [repeats]
+struct bench_arguments {
+    std::uint64_t n;
+    int repeats;
+};
+
+inline auto parse_arguments(int argc, char** argv, std::uint64_t default_n) -> bench_arguments {
+    return {
+	argc > 1 ? std::strtoull(argv[1], nullptr, 10) : default_n,
+	argc > 2 ? std::atoi(argv[2]) : 10,
+    };
+}
+
+// fastest of repeats runs in seconds, with the result of the last run
+template<typename Kernel>
+auto best_of(Kernel kernel, int repeats) -> std::pair<std::invoke_result_t<Kernel>, double> {
+    std::invoke_result_t<Kernel> result{};
+    auto best = std::chrono::nanoseconds::max();
+    for(int i = 0; i < repeats; ++i) {
+	auto start = std::chrono::steady_clock::now();
+	result = kernel();
+	best = std::min(best, std::chrono::steady_clock::now() - start);
+    }
+    return {result, std::chrono::duration<double>(best).count()};
+}
@@ -0,0 +1,32 @@
+#include <cstdint>
+#include <format>
+#include <iostream>
+
+#include "best_of.hpp"
+
+
+// defined by the compiled arrays.json, both sum a 1024 element array
+extern "C" auto sum_fixed(std::int32_t seed) -> std::int32_t;
+extern "C" auto sum_prefix(std::int32_t seed, std::uint64_t n) -> std::int32_t;
+
+auto main(int argc, char** argv) -> int {
+    auto [calls, repeats] = parse_arguments(argc, argv, 100'000);
+
+    // one timed run calls the kernel calls times, with a different seed each
+    auto calls_of = [calls] (auto kernel) {
+	return [calls, kernel] {
+	    std::int32_t result{};
+	    for(std::uint64_t call = 0; call < calls; ++call) {
+		result ^= kernel(static_cast<std::int32_t>(call));
+	    }
+	    return result;
+	};
+    };
+
+    auto [fixed, fixed_seconds] = best_of(calls_of(sum_fixed), repeats);
+    auto [prefix, prefix_seconds] = best_of(calls_of([] (std::int32_t seed) { return sum_prefix(seed, 1024); }), repeats);
+
+    std::cout << std::format("fixed  calls={} sum={} best={:.3f} ms\n", calls, fixed, fixed_seconds * 1e3);
+    std::cout << std::format("prefix calls={} sum={} best={:.3f} ms\n", calls, prefix, prefix_seconds * 1e3);
+    return 0;
+}
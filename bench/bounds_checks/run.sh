@@ -0,0 +1,52 @@
+#!/bin/sh
+# array loops at -O2 with and without bounds checks, checks whether the loop
+# vectorizer got to them and times both,
+# usage: bench/bounds_checks/run.sh <path to compiler> [calls] [repeats]
+# sum_fixed loops to the array length, the front end keeps its checks and the
+# O2 pipeline's ConstraintElimination may drop them, sum_prefix loops to an
+# argument so its checks stay. -fno-bounds-checks has to vectorize both,
+# the script fails if it does not
+set -e
+
+compiler=${1:?compiler binary}
+calls=${2:-100000}
+repeats=${3:-10}
+
+here=$(cd "$(dirname "$0")" && pwd)
+. "$here/../common.sh"
+
+# vectors <function> <ir>, i32 vector values in the optimized body
+vectors() {
+    sed -n '/^after optimization$/,$p' "$2" | sed -n "/^define.*@$1(/,/^}/p" | grep -c 'x i32>' || true
+}
+
+# traps <function> <ir>, bounds checks left in the optimized body
+traps() {
+    sed -n '/^after optimization$/,$p' "$2" | sed -n "/^define.*@$1(/,/^}/p" | grep -c 'call void @llvm.trap' || true
+}
+
+# counts <name>, what is left of both loops in one build
+counts() {
+    for function in sum_fixed sum_prefix; do
+	echo "$function: $(vectors $function "$work/$1.ll") vector values, $(traps $function "$work/$1.ll") traps"
+    done
+}
+
+run() {
+    name=$1
+    shift
+    compile "$name" "$here/arrays.json" -O2 "$@"
+    link "$name" "$name"
+    report "$name" counts "$name"
+    report "$name" "$work/$name" "$calls" "$repeats"
+}
+
+run checked
+run unchecked -fno-bounds-checks
+
+for function in sum_fixed sum_prefix; do
+    if [ "$(vectors $function "$work/unchecked.ll")" -eq 0 ]; then
+	echo "$function did not vectorize without bounds checks" >&2
+	exit 1
+    fi
+done
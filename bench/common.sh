@@ -0,0 +1,46 @@
+# sourced by the bench/*/run.sh scripts once they have set $compiler and $here,
+# builds go to a temporary directory that is removed on exit
+# RESULTS=<file> appends every reported line to file, after the date, the
+# host's architecture and the bench name, so runs on different machines can
+# be kept side by side
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+bench=$(basename "$here")
+
+# kernels are built for the host cpu, MARCH=<cpu> overrides it, generic
+# x86-64 has no fma or avx for contraction and wide reductions
+march=-march=${MARCH:-native}
+
+# compile <name> <json> [compiler flags], leaves $work/<name>.json.o and the
+# compiler's stderr, the module before and after optimization, in $work/<name>.ll
+compile() {
+    name=$1
+    source=$2
+    shift 2
+    cp "$source" "$work/$name.json"
+    "$compiler" "$@" "$work/$name.json" > /dev/null 2> "$work/$name.ll"
+}
+
+# link <binary> <name> [link flags], the bench's driver.cpp and
+# $work/<name>.json.o into $work/<binary>
+link() {
+    binary=$1
+    name=$2
+    shift 2
+    ${CXX:-c++} -std=c++20 -O2 -I"$here/.." "$@" "$here/driver.cpp" "$work/$name.json.o" -o "$work/$binary"
+}
+
+# report <label> <command...>, runs a driver and prints its lines after label
+report() {
+    label=$1
+    shift
+    output=$("$@")
+    printf '%s\n' "$output" | while IFS= read -r line; do
+	printf '%-10s%s\n' "$label" "$line"
+	if [ -n "$RESULTS" ]; then
+	    printf '%s %s %-14s%-10s%s\n' "$(date -u +%Y-%m-%d)" "$(uname -m)" "$bench" "$label" "$line" >> "$RESULTS"
+	fi
+    done
+}
@@ -0,0 +1,17 @@
+#include <cstdint>
+#include <format>
+#include <iostream>
+
+#include "best_of.hpp"
+
+
+// defined by the compiled reduction.json
+extern "C" auto sum(std::uint64_t n) -> double;
+
+auto main(int argc, char** argv) -> int {
+    auto [n, repeats] = parse_arguments(argc, argv, 100'000'000);
+
+    auto [result, seconds] = best_of([n] { return sum(n); }, repeats);
+    std::cout << std::format("n={} sum={:.6e} best={:.3f} ms {:.2f} elements/ns\n", n, result, seconds * 1e3, static_cast<double>(n) / (seconds * 1e9));
+    return 0;
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+# strict IEEE vs relaxed floating point on a sum-of-squares reduction,
+# usage: bench/fast_math/run.sh <path to compiler> [elements] [repeats]
+set -e
+
+compiler=${1:?compiler binary}
+elements=${2:-100000000}
+repeats=${3:-10}
+
+here=$(cd "$(dirname "$0")" && pwd)
+. "$here/../common.sh"
+
+run() {
+    name=$1
+    shift
+    compile "$name" "$here/reduction.json" -O2 "$march" "$@"
+    link "$name" "$name"
+    report "$name" "$work/$name" "$elements" "$repeats"
+}
+
+run strict
+run contract -ffp=contract
+run reassoc  -ffp=reassoc,contract
+run fast     -ffast-math
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "hash.hpp"
+#include "type/interner.hpp"
+#include "type/type_id.hpp"
+
+
+// every worker interns the same pool of signatures in its own order, so most
+// operations hit keys that other threads are reading or inserting right now
+
+using signature = std::pair<std::vector<type::type_id>, type::type_id>;
+
+class locked_interner {
+    struct signature_hash {
+	auto operator()(const signature& sig) const noexcept -> std::size_t {
+	    return hash_mix(span_hash<type::type_id>{}(sig.first), static_cast<std::uint64_t>(sig.second));
+	}
+    };
+
+    std::mutex _lock{};
+    std::unordered_map<signature, type::type_id, signature_hash> _ids{};
+    std::uint64_t _next{static_cast<std::uint64_t>(type::type_id::primitive_bound) + 1};
+
+public:
+    auto id(std::span<const type::type_id> params, type::type_id ret) -> type::type_id {
+	std::scoped_lock guard{_lock};
+	auto [iter, inserted] = _ids.try_emplace(signature{{params.begin(), params.end()}, ret}, type::type_id{_next});
+	if(inserted) {
+	    ++_next;
+	}
+	return iter->second;
+    }
+};
+
+auto make_signatures(std::size_t count) -> std::vector<signature> {
+    std::mt19937_64 engine{42};
+    std::uniform_int_distribution<std::uint64_t> primitive{
+	static_cast<std::uint64_t>(type::type_id::bool_),
+	static_cast<std::uint64_t>(type::type_id::fp64),
+    };
+    std::uniform_int_distribution<std::size_t> arity{0, 6};
+
+    std::vector<signature> signatures(count);
+    for(auto& [params, ret] : signatures) {
+	params.resize(arity(engine));
+	std::ranges::generate(params, [&] { return type::type_id{primitive(engine)}; });
+	ret = type::type_id{primitive(engine)};
+    }
+    return signatures;
+}
+
+template<typename Interner>
+auto run(Interner& interner, const std::vector<signature>& signatures, std::size_t threads, std::size_t rounds) -> double {
+    auto start = std::chrono::steady_clock::now();
+    {
+	std::vector<std::jthread> workers{};
+	workers.reserve(threads);
+	for(std::size_t worker = 0; worker < threads; ++worker) {
+	    workers.emplace_back([&interner, &signatures, rounds, worker] {
+		std::vector<std::size_t> order(signatures.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::ranges::shuffle(order, std::mt19937_64{worker});
+
+		std::uint64_t sink{};
+		for(std::size_t round = 0; round < rounds; ++round) {
+		    for(std::size_t index : order) {
+			sink += static_cast<std::uint64_t>(interner.id(signatures[index].first, signatures[index].second));
+		    }
+		}
+		if(sink == 0) {
+		    std::cerr << "unexpected" << std::endl;
+		}
+	    });
+	}
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+auto main() -> int {
+    constexpr std::size_t signature_count = 1U << 14U;
+    constexpr std::size_t rounds = 32;
+
+    auto signatures = make_signatures(signature_count);
+    std::size_t max_threads = std::max(1U, std::thread::hardware_concurrency());
+
+    std::cout << std::format("{:>8} {:>16} {:>16}\n", "threads", "sharded Mops/s", "mutex Mops/s");
+    for(std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+	type::interner sharded{};
+	locked_interner locked{};
+
+	double operations = static_cast<double>(threads * rounds * signature_count) / 1e6;
+	double sharded_time = run(sharded, signatures, threads, rounds);
+	double locked_time = run(locked, signatures, threads, rounds);
+
+	std::cout << std::format("{:>8} {:>16.2f} {:>16.2f}\n", threads, operations / sharded_time, operations / locked_time);
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#include <cstdint>
+#include <format>
+#include <iostream>
+
+#include "best_of.hpp"
+
+
+// defined by the compiled program.json
+extern "C" auto run(std::uint64_t n) -> std::uint64_t;
+
+auto main(int argc, char** argv) -> int {
+    auto [n, repeats] = parse_arguments(argc, argv, 100'000'000);
+
+    auto [result, seconds] = best_of([n] { return run(n); }, repeats);
+    std::cout << std::format("n={} result={} best={:.3f} ms\n", n, result, seconds * 1e3);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#!/bin/sh
+# O2 with and without a training profile on a loop with a rarely taken call,
+# usage: bench/pgo/run.sh <path to compiler> [iterations] [repeats]
+# needs clang++ for the profile runtime and llvm-profdata, both offline
+set -e
+
+compiler=${1:?compiler binary}
+iterations=${2:-100000000}
+repeats=${3:-10}
+profdata=${LLVM_PROFDATA:-llvm-profdata}
+CXX=${CXX:-clang++}
+
+here=$(cd "$(dirname "$0")" && pwd)
+. "$here/../common.sh"
+
+# build <binary> <link flags> [compiler flags], internal functions are named
+# after the module in the profile, so every build compiles the same path
+build() {
+    binary=$1
+    flags=$2
+    shift 2
+    compile program "$here/program.json" -O2 -fwrapv "$@"
+    link "$binary" program $flags
+}
+
+build plain ""
+report plain "$work/plain" "$iterations" "$repeats"
+
+# the instrumented program writes its counts through clang's profile runtime
+build instrumented -fprofile-generate --profile-generate="$work/program-%p.profraw"
+LLVM_PROFILE_FILE="$work/program-%p.profraw" "$work/instrumented" "$iterations" 1 > /dev/null
+"$profdata" merge -o "$work/program.profdata" "$work"/program-*.profraw
+
+build pgo "" --profile-use="$work/program.profdata"
+report pgo "$work/pgo" "$iterations" "$repeats"
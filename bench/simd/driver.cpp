@@ -0,0 +1,23 @@
+#include <cstdint>
+#include <format>
+#include <iostream>
+
+#include "best_of.hpp"
+
+
+// defined by the compiled kernels.json, n has to be a multiple of 8
+extern "C" auto squares_scalar(std::uint64_t n) -> float;
+extern "C" auto squares_simd(std::uint64_t n) -> float;
+
+auto main(int argc, char** argv) -> int {
+    // below 2^24 every x is exact in f32 and both kernels sum the same values
+    auto [n, repeats] = parse_arguments(argc, argv, 10'000'000);
+    n -= n % 8;
+
+    auto [scalar, scalar_seconds] = best_of([n] { return squares_scalar(n); }, repeats);
+    auto [simd, simd_seconds] = best_of([n] { return squares_simd(n); }, repeats);
+
+    std::cout << std::format("scalar n={} sum={:.6e} best={:.3f} ms\n", n, scalar, scalar_seconds * 1e3);
+    std::cout << std::format("simd   n={} sum={:.6e} best={:.3f} ms speedup {:.2f}x\n", n, simd, simd_seconds * 1e3, scalar_seconds / simd_seconds);
+    return 0;
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+# hand-vectorized f32x8 kernel vs the same loop written with scalars,
+# usage: bench/simd/run.sh <path to compiler> [elements] [repeats]
+set -e
+
+compiler=${1:?compiler binary}
+elements=${2:-10000000}
+repeats=${3:-10}
+
+here=$(cd "$(dirname "$0")" && pwd)
+. "$here/../common.sh"
+
+run() {
+    name=$1
+    shift
+    compile "$name" "$here/kernels.json" -O2 "$march" "$@"
+    link "$name" "$name"
+    report "$name" "$work/$name" "$elements" "$repeats"
+}
+
+# strict floating point keeps the scalar sum in order, only the explicit vectors run wide
+run strict
+# with reassociation the loop vectorizer can catch up on the scalar kernel
+run reassoc -ffp=reassoc
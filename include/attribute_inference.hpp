@@ -0,0 +1,11 @@
+#pragma once
+
+#include "tree.hpp"
+
+
+// bottom-up over the call graph of a typed file, fills function_info::attributes.
+// the language has no pointers and no way to unwind, so what is left to prove
+// is recursion and termination. when arithmetic may trap no function is
+// claimed to be free of side effects or to always return, with bounds checks
+// the same goes for every function indexing an array
+void infer_attributes(file_node& node, bool may_trap = false, bool bounds_checks = false);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+
+// blocking multi-producer multi-consumer queue, producers wait while it is full
+template<typename T>
+class bounded_queue {
+    mutable std::mutex _lock{};
+    std::condition_variable _not_full{};
+    std::condition_variable _not_empty{};
+    std::deque<T> _items{};
+    std::size_t _capacity;
+    bool _closed{};
+
+    // depth seen by producers right after pushing, kept for metrics
+    std::size_t _max_depth{};
+    std::size_t _depth_sum{};
+    std::size_t _pushes{};
+
+public:
+    explicit bounded_queue(std::size_t capacity) : _capacity{std::max<std::size_t>(capacity, 1)} {}
+
+    bounded_queue(const bounded_queue&)                    = delete;
+    bounded_queue(bounded_queue&&)                         = delete;
+    auto operator=(const bounded_queue&) -> bounded_queue& = delete;
+    auto operator=(bounded_queue&&) -> bounded_queue&      = delete;
+    ~bounded_queue()                                       = default;
+
+    // returns false if the queue was closed and the item dropped
+    auto push(T item) -> bool {
+	{
+	    std::unique_lock guard{_lock};
+	    _not_full.wait(guard, [this] { return _closed || _items.size() < _capacity; });
+	    if(_closed) {
+		return false;
+	    }
+
+	    _items.push_back(std::move(item));
+	    _max_depth = std::max(_max_depth, _items.size());
+	    _depth_sum += _items.size();
+	    ++_pushes;
+	}
+	_not_empty.notify_one();
+	return true;
+    }
+
+    // empty optional once the queue is closed and drained
+    auto pop() -> std::optional<T> {
+	std::optional<T> item{};
+	{
+	    std::unique_lock guard{_lock};
+	    _not_empty.wait(guard, [this] { return _closed || !_items.empty(); });
+	    if(_items.empty()) {
+		return {};
+	    }
+
+	    item = std::move(_items.front());
+	    _items.pop_front();
+	}
+	_not_full.notify_one();
+	return item;
+    }
+
+    void close() {
+	{
+	    std::scoped_lock guard{_lock};
+	    _closed = true;
+	}
+	_not_full.notify_all();
+	_not_empty.notify_all();
+    }
+
+    auto capacity() const noexcept -> std::size_t { return _capacity; }
+
+    auto max_depth() const -> std::size_t {
+	std::scoped_lock guard{_lock};
+	return _max_depth;
+    }
+
+    auto average_depth() const -> double {
+	std::scoped_lock guard{_lock};
+	return _pushes == 0 ? 0.0 : static_cast<double>(_depth_sum) / static_cast<double>(_pushes);
+    }
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <any_tree.hpp>
+
+#include "any_tree/visitor.hpp"
+#include "tree.hpp"
+
+
+// direct calls between the functions of a file, indices follow the order of file_node children
+class call_graph {
+public:
+    using visitor = any_tree::const_children_visitor<void>;
+
+private:
+    struct function_facts {
+	std::vector<std::size_t> callees{};
+	bool has_loop{};
+	// calls something that is not defined in this file
+	bool calls_unknown{};
+	// indexes an array, which traps when bounds are checked
+	bool has_index{};
+    };
+
+    std::unordered_map<std::string, std::size_t> _indices{};
+    std::vector<function_facts> _facts{};
+    function_facts* _current{};
+
+    visitor _visitor;
+
+public:
+    explicit call_graph(const file_node& node);
+
+    call_graph(const call_graph&)                    = delete;
+    call_graph(call_graph&&)                         = delete;
+    auto operator=(const call_graph&) -> call_graph& = delete;
+    auto operator=(call_graph&&) -> call_graph&      = delete;
+    ~call_graph()                                    = default;
+
+    auto size() const noexcept -> std::size_t { return _facts.size(); }
+
+    auto callees(std::size_t index)       const noexcept -> std::span<const std::size_t> { return _facts[index].callees; }
+    auto has_loop(std::size_t index)      const noexcept -> bool { return _facts[index].has_loop; }
+    auto calls_unknown(std::size_t index) const noexcept -> bool { return _facts[index].calls_unknown; }
+    auto has_index(std::size_t index)     const noexcept -> bool { return _facts[index].has_index; }
+
+    // strongly connected components, callees come before their callers
+    auto strongly_connected() const -> std::vector<std::vector<std::size_t>>;
+
+    // functions reachable from the roots, roots included
+    auto reachable(std::span<const std::size_t> roots) const -> std::vector<bool>;
+};
@@ -1,5 +1,15 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
@@ -8,11 +18,39 @@
 
 #include "tree.hpp"
 #include "scope.hpp"
+#include "fp_flags.hpp"
 #include "functions.hpp"
+#include "ssa_builder.hpp"
 #include "type/type_id.hpp"
 #include "type/registry.hpp"
 
 
+// lowering of if expressions whose arms have no side effects and cannot trap
+enum class select_mode {
+    never,
+    // when both arms together cost at most codegen_options::select_cost
+    cheap,
+    always,
+};
+
+struct codegen_options {
+    // build SSA values directly, otherwise every local goes through an alloca
+    bool ssa{true};
+    // turn self tail calls into a jump back to the start of the function
+    bool tail_loops{};
+    // default for functions without "funcFastMath"
+    fp_flags fast_math{fp_flags::none};
+    // trap on out of range array indexes
+    bool bounds_checks{true};
+    // integer + - * branch to a trap on overflow, set with -ftrapv
+    bool checked_arithmetic{};
+    select_mode selects{select_mode::cheap};
+    // operators, casts and builtin calls in both arms of an if expression
+    std::size_t select_cost{4};
+    // DWARF line tables from the "pos" of the source, variables and types are not described
+    bool line_tables{};
+};
+
 class code_generator {
 public:
     using visitor = any_tree::const_children_visitor<llvm::Value*>;
@@ -22,10 +60,43 @@ private:
     llvm::IRBuilder<> _builder;
     llvm::Module _module;
 
-    scope_manager<llvm::AllocaInst*, llvm::Function*> _scope{};
-    scope<llvm::Function*, void> _functions{};
+    scope_manager<ssa_builder::variable*, llvm::Function*> _scope{};
+    // indexed by function_info::index and call_info::callee_index
+    std::vector<llvm::Function*> _prototypes{};
     special_functions* _special;
     type::registry* _types;
+    codegen_options _options;
+
+    ssa_builder _ssa{};
+
+    // string literals of the module, each distinct one is emitted once
+    std::unordered_map<std::string, llvm::GlobalVariable*> _strings{};
+
+    // compile unit of the module when line tables are emitted
+    std::unique_ptr<llvm::DIBuilder> _debug{};
+    llvm::DICompileUnit* _unit{};
+
+    // state of the function being generated
+    std::vector<ssa_builder::variable*> _params{};
+    llvm::BasicBlock* _tail_header{};
+    llvm::DISubprogram* _subprogram{};
+
+    // instructions emitted while it lives are attributed to position, the
+    // location of the enclosing node is restored afterwards
+    class location_pusher {
+	llvm::IRBuilderBase* _builder;
+	llvm::DebugLoc _saved;
+
+    public:
+	location_pusher(code_generator* generator, const source_position& position);
+	~location_pusher() { _builder->SetCurrentDebugLocation(_saved); }
+
+	location_pusher()                            = delete;
+	location_pusher(const location_pusher&)      = delete;
+	location_pusher(location_pusher&&)           = delete;
+	auto operator=(const location_pusher&)       = delete;
+	auto operator=(location_pusher&&)            = delete;
+    };
 
     visitor _visitor;
 
@@ -41,18 +112,59 @@ private:
     auto loop_stmt       (const visitor& visitor, const loop_node& node)             -> llvm::Value*;
     auto block           (const visitor& visitor, const block_node& node)            -> llvm::Value*;
     auto call            (const visitor& visitor, const call_node& node)             -> llvm::Value*;
+    auto builtin_call    (const visitor& visitor, const call_node& node)             -> llvm::Value*;
     auto implicit_cast   (const visitor& visitor, const implicit_cast_node& node)    -> llvm::Value*;
+    auto array_literal   (const visitor& visitor, const array_literal_node& node)    -> llvm::Value*;
+    auto index           (const visitor& visitor, const index_node& node)            -> llvm::Value*;
+    auto struct_literal  (const visitor& visitor, const struct_literal_node& node)   -> llvm::Value*;
+    auto field           (const visitor& visitor, const field_node& node)            -> llvm::Value*;
 
     auto identifier(const identifier_node& node) -> llvm::Value*;
+    auto assign(const visitor& visitor, const binary_expr_node& node) -> llvm::Value*;
+    auto assign_in_place(const visitor& visitor, const binary_expr_node& node) -> llvm::Value*;
+
+    // addresses of elements and fields, type is only needed when node is a temporary
+    auto element_address(const visitor& visitor, const index_node& node) -> llvm::Value*;
+    auto field_address(const visitor& visitor, const field_node& node) -> llvm::Value*;
+    auto address_of(const visitor& visitor, const std::any& node, llvm::Type* type) -> llvm::Value*;
+    auto in_memory(const std::any& node) -> bool;
+    void bounds_check(llvm::Value* index, std::uint64_t length);
+
+    auto tail_call     (const visitor& visitor, const call_node& node) -> llvm::Value*;
+    auto self_tail_call(const visitor& visitor, const call_node& node) -> llvm::Value*;
+    void branch_to(llvm::BasicBlock* target);
+
+    // both arms evaluated unconditionally, chosen by a select instead of a branch
+    auto select(const visitor& visitor, const if_else_expr_node& node, llvm::Value* cond) -> llvm::Value*;
+    auto speculation_cost(const std::any& node) const -> std::optional<std::size_t>;
+    auto arm_cost(const std::any& block) const -> std::optional<std::size_t>;
+
+    auto loop_metadata(const loop_info& info, bool has_condition) -> llvm::MDNode*;
+    auto subprogram(const function_info& info, llvm::Function* func) -> llvm::DISubprogram*;
+    // !prof for a conditional branch, null without a hint
+    auto branch_weights(std::optional<bool> likely) -> llvm::MDNode*;
+    auto loop_weights(const loop_info& info) -> llvm::MDNode*;
+
+    auto make_variable(const std::string& name, llvm::Type* type) -> ssa_builder::variable*;
+    auto read_variable(const ssa_builder::variable* var) -> llvm::Value*;
+    void write_variable(const ssa_builder::variable* var, llvm::Value* value);
 
     auto integer_literal (const integer_literal_node& node)  -> llvm::Value*;
     auto floating_literal(const floating_literal_node& node) -> llvm::Value*;
     auto char_literal    (const char_literal_node& node)     -> llvm::Value*;
     auto string_literal  (const string_literal_node& node)   -> llvm::Value*;
+    auto string_constant (const std::string& value)           -> llvm::GlobalVariable*;
     auto bool_literal    (const bool_literal_node& node)     -> llvm::Value*;
 
 public:
-    code_generator(const std::string& module_name, llvm::LLVMContext* context, special_functions* special, type::registry* types);
+    code_generator(const std::string& module_name, llvm::LLVMContext* context, special_functions* special, type::registry* types, codegen_options options = {});
+
+    // prototype only, lowering the function later fills in its body.
+    // functions have to be declared in file order
+    auto declare(const function_info& info) -> llvm::Function*;
+
+    // resolves the debug info of every generated function, call once all are lowered
+    void finish();
 
     auto get_visitor() -> visitor& { return _visitor; }
     auto get_module() -> llvm::Module& { return _module; };
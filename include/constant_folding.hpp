@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+#include "interpreter.hpp"
+#include "tree.hpp"
+
+
+// bottom-up over the typed file, between semantic analysis and code generation.
+// operators and casts on literals become literals, lets initialized with a
+// literal and never assigned are replaced by it at every use, and calls to pure
+// functions whose arguments end up literal are run by the interpreter, which
+// needs the attributes from infer_attributes. returns how many nodes were replaced
+auto fold_constants(file_node& node, interpreter_options options = {}) -> std::size_t;
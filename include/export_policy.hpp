@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "tree.hpp"
+
+
+// decides which functions keep external linkage: main, functions marked
+// "funcExported" in the source and names given on the command line. A file
+// without any of them is treated as a library and everything is exported
+class export_policy {
+    std::unordered_set<std::string> _names{};
+
+    auto is_root(const function_info& info) const -> bool;
+
+public:
+    export_policy() = default;
+    explicit export_policy(std::span<const std::string> names) : _names{names.begin(), names.end()} {}
+
+    void mark(std::span<function_info> functions) const;
+
+    // marks exported functions and drops the ones no export can call,
+    // returns how many were dropped
+    auto prune(file_node& node) const -> std::size_t;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+
+// floating point relaxations, a front end copy of llvm::FastMathFlags so the
+// tree does not depend on LLVM
+enum class fp_flags : std::uint8_t {
+    none            = 0,
+    reassoc         = 1U << 0U,
+    contract        = 1U << 1U,
+    no_nans         = 1U << 2U,
+    no_infs         = 1U << 3U,
+    arcp            = 1U << 4U,
+    no_signed_zeros = 1U << 5U,
+    approx_func     = 1U << 6U,
+    fast            = (1U << 7U) - 1,
+};
+
+constexpr inline auto operator|(fp_flags lhs, fp_flags rhs) -> fp_flags {
+    using fp_flags_underlying = std::underlying_type_t<fp_flags>;
+    return static_cast<fp_flags>(static_cast<fp_flags_underlying>(lhs) | static_cast<fp_flags_underlying>(rhs));
+}
+
+constexpr inline auto operator|=(fp_flags& lhs, fp_flags rhs) -> fp_flags& {
+    return lhs = lhs | rhs;
+}
+
+constexpr inline auto has(fp_flags flags, fp_flags flag) -> bool {
+    using fp_flags_underlying = std::underlying_type_t<fp_flags>;
+    return (static_cast<fp_flags_underlying>(flags) & static_cast<fp_flags_underlying>(flag)) != 0;
+}
+
+// names follow the LLVM IR keywords
+constexpr inline auto parse_fp_flag(std::string_view name) -> std::optional<fp_flags> {
+    if(name == "reassoc")  { return fp_flags::reassoc; }
+    if(name == "contract") { return fp_flags::contract; }
+    if(name == "nnan")     { return fp_flags::no_nans; }
+    if(name == "ninf")     { return fp_flags::no_infs; }
+    if(name == "arcp")     { return fp_flags::arcp; }
+    if(name == "nsz")      { return fp_flags::no_signed_zeros; }
+    if(name == "afn")      { return fp_flags::approx_func; }
+    if(name == "fast")     { return fp_flags::fast; }
+    return {};
+}
+
+// comma separated list of flag names
+constexpr inline auto parse_fp_flags(std::string_view names) -> std::optional<fp_flags> {
+    fp_flags flags = fp_flags::none;
+    while(!names.empty()) {
+	std::size_t comma = names.find(',');
+	auto flag = parse_fp_flag(names.substr(0, comma));
+	if(!flag.has_value()) {
+	    return {};
+	}
+	flags |= *flag;
+	names = comma == std::string_view::npos ? std::string_view{} : names.substr(comma + 1);
+    }
+    return flags;
+}
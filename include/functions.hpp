@@ -5,6 +5,8 @@
 #include <utility>
 #include <functional>
 #include <optional>
+#include <span>
+#include <vector>
 
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Value.h>
@@ -89,19 +91,80 @@ public:
     auto empty() const { return _binary.empty(); }
 };
 
+// function provided by the compiler, overloaded on the type of its first argument.
+// the remaining arguments are cast to the parameters like for any other call
+class builtin_function {
+public:
+    using builtin_inserter = llvm::Value*(llvm::IRBuilderBase*, std::span<llvm::Value* const>);
+    using inserter_wrapper = std::function<builtin_inserter>;
+
+    struct overload {
+	std::vector<type::type_id> params;
+	type::type_id return_type;
+	inserter_wrapper inserter;
+    };
+
+private:
+    std::unordered_map<type::type_id, overload> _overloads{};
+
+public:
+    auto get(type::type_id first) const -> const overload*;
+    // keyed by the type of the first parameter
+    inline auto overloads() const noexcept -> const std::unordered_map<type::type_id, overload>& { return _overloads; }
+    void insert(std::vector<type::type_id> params, type::type_id return_type, inserter_wrapper inserter);
+
+    auto empty() const { return _overloads.empty(); }
+};
+
 class special_functions {
     std::unordered_map<type::type_id, casts> _casts{};
     std::unordered_map<std::string, unary_operator> _unary{};
     std::unordered_map<std::string, binary_operator> _binary{};
+    std::unordered_map<std::string, builtin_function> _builtins{};
 
 public:
     inline auto cast(type::type_id from_type) noexcept -> casts& { return _casts[from_type]; }
     inline auto unary(const std::string& oper) noexcept -> unary_operator& { return _unary[oper]; }
     inline auto binary(const std::string& oper) noexcept -> binary_operator& { return _binary[oper]; }
+    inline auto builtin(const std::string& name) noexcept -> builtin_function& { return _builtins[name]; }
+
+    // lookups that never insert, safe to share between threads once populated
+    auto cast(type::type_id from_type) const noexcept -> const casts&;
+    auto unary(const std::string& oper) const noexcept -> const unary_operator&;
+    auto binary(const std::string& oper) const noexcept -> const binary_operator&;
+    auto builtin(const std::string& name) const noexcept -> const builtin_function&;
 
     auto new_unary(const std::string& oper, std::uint64_t precedense) noexcept -> bool;
     auto new_binary(const std::string& oper, std::uint64_t precedense) noexcept -> bool;
 };
 
+// integer + - * overflow: undefined by default for signed types (nsw, the
+// optimizer may assume it never happens), wraps around with -fwrapv, aborts
+// with -ftrapv
+enum class overflow_mode {
+    undefined,
+    wrap,
+    trap,
+};
+
+struct arithmetic_options {
+    overflow_mode overflow{overflow_mode::undefined};
+    // unsigned arithmetic wraps unless overflow traps, this makes it undefined
+    // (nuw) too, set with -fno-unsigned-wrap
+    bool unsigned_undefined{};
+
+    constexpr auto mode(bool is_signed) const noexcept -> overflow_mode {
+	if(!is_signed && overflow == overflow_mode::undefined && !unsigned_undefined) {
+	    return overflow_mode::wrap;
+	}
+	return overflow;
+    }
+};
+
 void default_casts(special_functions& functions, type::registry& types);
-void default_binaries(special_functions& functions);
+void default_binaries(special_functions& functions, arithmetic_options options = {});
+// element-wise operators on the SIMD types and the builtins working on them,
+// registered after default_binaries
+void default_vectors(special_functions& functions, type::registry& types);
+// builtins on string slices
+void default_strings(special_functions& functions);
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <concepts>
 #include <cstdint>
+#include <span>
 #include <type_traits>
 #include <vector>
 
@@ -31,12 +33,30 @@ using integral_type_t = typename integral_type<T>::type;
 } // namespace
 
 
+// the gcc/clang 128 bit type, __extension__ keeps -pedantic quiet about it
+__extension__ typedef unsigned __int128 hash_uint128;
+
+// wyhash style 64x64 -> 128 multiply folded back to 64 bits
+constexpr inline auto hash_mix(std::uint64_t lhs, std::uint64_t rhs) noexcept -> std::uint64_t {
+    hash_uint128 product = static_cast<hash_uint128>(lhs) * rhs;
+    return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64U);
+}
+
+constexpr inline std::uint64_t hash_seed_0 = 0xa0761d6478bd642fULL;
+constexpr inline std::uint64_t hash_seed_1 = 0xe7037ed1a0b428dbULL;
+constexpr inline std::uint64_t hash_seed_2 = 0x8ebc6af09c88c6e3ULL;
+
+
 template<typename T, typename U>
 struct pair_hash;
 
 template<typename T>
 requires integral<T>
-struct vector_hash;
+struct span_hash;
+
+template<typename T>
+requires integral<T>
+struct span_equal;
 
 template<typename T>
 struct hash_for {
@@ -45,7 +65,12 @@ struct hash_for {
 
 template<typename T>
 struct hash_for<std::vector<T>> {
-    using type = vector_hash<T>;
+    using type = span_hash<T>;
+};
+
+template<typename T>
+struct hash_for<std::span<const T>> {
+    using type = span_hash<T>;
 };
 
 template<typename T, typename U>
@@ -59,24 +84,39 @@ using hash_for_t = typename hash_for<T>::type;
 
 template<typename T>
 requires integral<T>
-struct vector_hash {
-    auto operator()(const std::vector<T>& vec) const noexcept -> std::size_t {
+struct span_hash {
+    using is_transparent = void;
+
+    auto operator()(std::span<const T> values) const noexcept -> std::size_t {
 	using int_t = integral_type_t<T>;
 
-	std::size_t seed = vec.size();
-	for(const auto& elem : vec) {
-	    seed ^= static_cast<int_t>(elem) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	std::uint64_t seed = hash_mix(values.size() ^ hash_seed_0, hash_seed_1);
+	for(const auto& elem : values) {
+	    seed = hash_mix(seed ^ static_cast<std::uint64_t>(static_cast<int_t>(elem)), hash_seed_2);
 	}
 	return seed;
     }
+
+    auto operator()(const std::vector<T>& values) const noexcept -> std::size_t {
+	return (*this)(std::span<const T>{values});
+    }
+};
+
+template<typename T>
+requires integral<T>
+struct span_equal {
+    using is_transparent = void;
+
+    auto operator()(std::span<const T> lhs, std::span<const T> rhs) const noexcept -> bool {
+	return std::ranges::equal(lhs, rhs);
+    }
 };
 
 template<typename T, typename U>
 struct pair_hash {
     auto operator()(const std::pair<T, U>& pair) const noexcept -> std::size_t {
-	uintmax_t hash = hash_for_t<T>{}(pair.first);
-        hash <<= sizeof(uintmax_t) * 4;
-        hash ^= hash_for_t<U>{}(pair.second);
-        return std::hash<uintmax_t>{}(hash);
+	std::uint64_t first = hash_for_t<T>{}(pair.first);
+	std::uint64_t second = hash_for_t<U>{}(pair.second);
+	return hash_mix(first ^ hash_seed_0, second ^ hash_seed_1);
     }
 };
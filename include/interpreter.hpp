@@ -0,0 +1,93 @@
+#pragma once
+
+#include <any>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <span>
+#include <string>
+
+#include <any_tree.hpp>
+
+#include "any_tree/visitor.hpp"
+#include "functions.hpp"
+#include "scope.hpp"
+#include "tree.hpp"
+#include "type/type_id.hpp"
+
+
+// scalar value of the interpreter. integers, chars and bools are kept
+// truncated to the width of their type, fp32 values are rounded to float
+struct constant {
+    type::type_id type;
+    std::uint64_t integer;
+    double floating;
+};
+
+struct interpreter_options {
+    // nodes evaluated per top-level call before giving up, 0 turns evaluation off
+    std::size_t step_budget{100'000};
+    // calls nested deeper than this give up instead of exhausting the stack
+    std::size_t max_depth{256};
+    arithmetic_options arithmetic{};
+};
+
+// evaluates pure functions of a typed file at compile time. anything whose
+// result the generated code would not pin down, overflow with undefined
+// semantics, division by zero, reading an unset variable, non-finite floats,
+// or anything that is not a scalar, gives up instead of guessing
+class interpreter {
+public:
+    using visitor = any_tree::const_children_visitor<std::optional<constant>>;
+
+private:
+    const file_node* _file;
+    interpreter_options _options;
+
+    std::size_t _steps{};
+    std::size_t _depth{};
+    // set by a return statement until the call it leaves is reached
+    std::optional<constant> _returned{};
+
+    // variables live in the deque so scopes can hand out stable pointers
+    std::deque<std::optional<constant>> _values{};
+    scope_manager<std::optional<constant>*, const function_node*> _scope{};
+
+    visitor _visitor;
+
+    auto evaluate(const std::any& node) -> std::optional<constant>;
+    auto statements(std::span<const std::any> nodes) -> std::optional<constant>;
+    auto invoke(const function_node& node, std::span<const constant> arguments) -> std::optional<constant>;
+
+    auto return_statement(const return_statement_node& node) -> std::optional<constant>;
+    auto var_def         (const var_def_node& node)          -> std::optional<constant>;
+    auto binary_expr     (const binary_expr_node& node)      -> std::optional<constant>;
+    auto if_stmt         (const if_node& node)               -> std::optional<constant>;
+    // the statement and the expression form
+    auto if_else         (const auto& node)                  -> std::optional<constant>;
+    auto loop_stmt       (const loop_node& node)             -> std::optional<constant>;
+    auto call            (const call_node& node)             -> std::optional<constant>;
+    auto implicit_cast   (const implicit_cast_node& node)    -> std::optional<constant>;
+    auto identifier      (const identifier_node& node)       -> std::optional<constant>;
+
+public:
+    interpreter(const file_node* file, interpreter_options options = {});
+
+    interpreter(const interpreter&)                    = delete;
+    interpreter(interpreter&&)                         = delete;
+    auto operator=(const interpreter&) -> interpreter& = delete;
+    auto operator=(interpreter&&) -> interpreter&      = delete;
+    ~interpreter()                                     = default;
+
+    // result of the function at index called with arguments, each call starts a fresh budget
+    auto run(std::size_t index, std::span<const constant> arguments) -> std::optional<constant>;
+
+    // an operator of default_binaries on operands of type, and a conversion of default_casts
+    static auto binary(const std::string& oper, constant lhs, constant rhs, type::type_id type, arithmetic_options arithmetic) -> std::optional<constant>;
+    static auto cast(constant value, type::type_id to_type) -> std::optional<constant>;
+
+    // literal leaves of the tree and back
+    static auto from_literal(const std::any& node) -> std::optional<constant>;
+    static auto to_literal(constant value) -> std::any;
+};
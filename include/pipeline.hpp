@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include "code_generator.hpp"
+#include "export_policy.hpp"
+#include "functions.hpp"
+#include "tree.hpp"
+#include "type/interner.hpp"
+
+
+struct stage_metrics {
+    std::string name;
+    std::size_t items;
+    std::size_t workers;
+    double busy_seconds;
+    double wall_seconds;
+    // depth of the queue feeding the stage, zero capacity for the first one
+    std::size_t queue_capacity;
+    std::size_t max_queue_depth;
+    double average_queue_depth;
+
+    auto throughput() const noexcept -> double { return wall_seconds > 0 ? static_cast<double>(items) / wall_seconds : 0.0; }
+};
+
+// streams functions through tree building, semantic analysis and lowering
+// (code generation followed by function level optimization) with bounded
+// queues in between, a function moves on as soon as the previous stage is
+// done with it, callee signatures are read from the json before starting.
+// every function is compiled, there is no call graph to prune with up front.
+// unlike the tree based flow in main, attributes are inferred and
+// unreachable functions dropped by LLVM's passes after lowering, so they are
+// not in the prototypes functions are lowered against, and there is no
+// compile-time evaluation of pure calls (-fconstexpr-steps is rejected),
+// only the folding the function pass pipeline does from -O1 on.
+// at most queue_capacity functions are in flight at a time, a function is
+// not built before the one queue_capacity places ahead of it is lowered
+class pipeline {
+    const special_functions* _special;
+    type::interner* _types;
+    code_generator* _generator;
+    const export_policy* _exports;
+    llvm::TargetMachine* _target;
+    llvm::OptimizationLevel _level;
+    std::size_t _workers;
+    std::size_t _queue_capacity;
+
+    std::vector<stage_metrics> _metrics{};
+
+public:
+    pipeline(const special_functions* special, type::interner* types, code_generator* generator, const export_policy* exports, llvm::TargetMachine* target, llvm::OptimizationLevel level, std::size_t workers, std::size_t queue_capacity = 64)
+	: _special{special}
+	, _types{types}
+	, _generator{generator}
+	, _exports{exports}
+	, _target{target}
+	, _level{level}
+	, _workers{workers}
+	, _queue_capacity{queue_capacity}
+    {}
+
+    pipeline()                                 = delete;
+    pipeline(const pipeline&)                  = delete;
+    pipeline(pipeline&&)                       = delete;
+    auto operator=(const pipeline&) -> pipeline& = delete;
+    auto operator=(pipeline&&) -> pipeline&      = delete;
+    ~pipeline()                                = default;
+
+    auto run(const json& object) -> bool;
+
+    auto metrics() const noexcept -> const std::vector<stage_metrics>& { return _metrics; }
+};
+
+auto operator<<(std::ostream& out, const std::vector<stage_metrics>& metrics) -> std::ostream&;
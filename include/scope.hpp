@@ -29,7 +29,7 @@ class scope<T, void> {
     std::unordered_map<std::string, T> _symbols{};
 
 public:
-    auto get(const std::string& name) noexcept -> std::optional<T> {
+    auto get(const std::string& name) const noexcept -> std::optional<T> {
 	if(auto iter = _symbols.find(name); iter != _symbols.end()) {
 	    return iter->second;
 	}
@@ -57,8 +57,8 @@ public:
     void push(F function) noexcept { _scopes.emplace_back(function); }
     void pop() noexcept { _scopes.pop_back(); }
 
-    auto get(const std::string& name) noexcept -> std::optional<T> {
-	for(auto& scope : _scopes | std::views::reverse) {
+    auto get(const std::string& name) const noexcept -> std::optional<T> {
+	for(const auto& scope : _scopes | std::views::reverse) {
 	    if(auto value = scope.get(name); value.has_value()) {
 		return value;
 	    }
@@ -1,26 +1,46 @@
 #pragma once
 
+#include <cstddef>
+#include <optional>
+#include <span>
+
 #include <any_tree.hpp>
 
 #include "any_tree/visitor.hpp"
 #include "functions.hpp"
 #include "tree.hpp"
 #include "scope.hpp"
+#include "thread_pool.hpp"
 #include "type/type_id.hpp"
-#include "type/registry.hpp"
+#include "type/interner.hpp"
 
 
 class semantic_analyzer {
 public:
     using visitor = any_tree::children_visitor<type::type_id>;
 
+    // type and position in the file, the position is what code generation uses to find the prototype
+    struct function_entry {
+	type::type_id type;
+	std::size_t index;
+    };
+    using function_table = scope<function_entry, void>;
+
 private:
     scope_manager<type::type_id> _scope{};
-    special_functions* _special;
-    type::registry* _types;
+    const special_functions* _special;
+    type::interner* _types;
+    thread_pool* _pool;
+
+    // signatures of every function in the file, immutable while bodies are analyzed
+    const function_table* _functions{};
 
     visitor _visitor;
 
+    auto lookup(const std::string& name) const noexcept -> type::type_id;
+    auto lookup_function(const std::string& name) const noexcept -> std::optional<function_entry>;
+    auto collect_functions(file_node& node) -> function_table;
+
     auto file            (const visitor& visitor, file_node& node)             -> type::type_id;
     auto function        (const visitor& visitor, function_node& node)         -> type::type_id;
     auto return_statement(const visitor& visitor, return_statement_node& node) -> type::type_id;
@@ -33,6 +53,22 @@ private:
     auto loop_stmt       (const visitor& visitor, loop_node& node)             -> type::type_id;
     auto block           (const visitor& visitor, block_node& node)            -> type::type_id;
     auto call            (const visitor& visitor, call_node& node)             -> type::type_id;
+    auto builtin_call    (const visitor& visitor, call_node& node)             -> type::type_id;
+    auto array_literal   (const visitor& visitor, array_literal_node& node)    -> type::type_id;
+    auto index           (const visitor& visitor, index_node& node)            -> type::type_id;
+    auto struct_literal  (const visitor& visitor, struct_literal_node& node)   -> type::type_id;
+    auto field           (const visitor& visitor, field_node& node)            -> type::type_id;
+
+    // overload of a builtin picked by a literal first argument
+    auto literal_overload(const builtin_function& builtin, type::type_id literal) const -> const builtin_function::overload*;
+    // checks and casts the arguments of a call starting at position from
+    auto arguments(const visitor& visitor, call_node& node, std::span<const type::type_id> params, std::size_t from) -> bool;
+
+    // visits node and casts it to type if needed
+    auto coerce(const visitor& visitor, std::any& node, type::type_id type) -> bool;
+
+    // array literals take their element type from the place they are stored to
+    void expect(std::any& node, type::type_id type) const noexcept;
 
     auto identifier (identifier_node& node) -> type::type_id;
 
@@ -43,7 +79,11 @@ private:
     static auto bool_literal    (bool_literal_node& node)     -> type::type_id;
 
 public:
-    semantic_analyzer(special_functions* special, type::registry* types);
+    semantic_analyzer(const special_functions* special, type::interner* types, thread_pool* pool = nullptr);
 
     auto get_visitor() -> visitor& { return _visitor; }
+
+    // analyze a single function against signatures collected beforehand
+    auto analyze_function(std::any& node, const function_table& functions) -> type::type_id;
+    auto collect_functions(std::span<const function_info> signatures) -> function_table;
 };
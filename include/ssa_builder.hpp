@@ -0,0 +1,61 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Type.h>
+#include <llvm/IR/Value.h>
+#include <llvm/IR/ValueHandle.h>
+
+#include "hash.hpp"
+
+
+// on the fly SSA construction from Braun et al., "Simple and Efficient
+// Construction of Static Single Assignment Form", phis are placed while the
+// body is being emitted instead of going through memory and mem2reg
+class ssa_builder {
+public:
+    struct variable {
+	std::string name;
+	llvm::Type* type;
+	// variables that have to live in memory keep their slot, they are never tracked here
+	llvm::AllocaInst* slot;
+    };
+
+private:
+    using definition_key = std::pair<const variable*, const llvm::BasicBlock*>;
+
+    // deque keeps the addresses handed to scopes stable
+    std::deque<variable> _variables{};
+
+    // value handles follow replaceAllUsesWith, removed phis never stay behind here
+    std::unordered_map<definition_key, llvm::WeakTrackingVH, pair_hash<const variable*, const llvm::BasicBlock*>> _definitions{};
+
+    // blocks are sealed by default, loop headers are not until their back edge exists
+    std::unordered_set<const llvm::BasicBlock*> _unsealed{};
+    std::unordered_map<const llvm::BasicBlock*, std::vector<std::pair<const variable*, llvm::PHINode*>>> _incomplete{};
+
+    auto read_recursive(const variable* var, llvm::BasicBlock* block) -> llvm::Value*;
+    auto add_phi_operands(const variable* var, llvm::PHINode* phi) -> llvm::Value*;
+    auto try_remove_trivial_phi(llvm::PHINode* phi) -> llvm::Value*;
+
+    static auto make_phi(const variable* var, llvm::BasicBlock* block) -> llvm::PHINode*;
+
+public:
+    auto make_variable(std::string name, llvm::Type* type, llvm::AllocaInst* slot = nullptr) -> variable*;
+
+    void write(const variable* var, const llvm::BasicBlock* block, llvm::Value* value);
+    auto read(const variable* var, llvm::BasicBlock* block) -> llvm::Value*;
+
+    void unseal(const llvm::BasicBlock* block) { _unsealed.insert(block); }
+    void seal(llvm::BasicBlock* block);
+
+    // drops everything, variables handed out before become dangling
+    void clear();
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <latch>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class thread_pool {
+    std::mutex _lock{};
+    std::condition_variable _ready{};
+    std::deque<std::function<void()>> _tasks{};
+    bool _stopping{};
+
+    // declared last so workers are joined before the queue goes away
+    std::vector<std::jthread> _workers{};
+
+    void work();
+    // true on the pool's own worker threads
+    auto on_worker() const noexcept -> bool;
+
+public:
+    explicit thread_pool(std::size_t threads = std::thread::hardware_concurrency());
+
+    thread_pool(const thread_pool&)                    = delete;
+    thread_pool(thread_pool&&)                         = delete;
+    auto operator=(const thread_pool&) -> thread_pool& = delete;
+    auto operator=(thread_pool&&) -> thread_pool&      = delete;
+    ~thread_pool();
+
+    auto size() const noexcept -> std::size_t { return _workers.size(); }
+
+    void submit(std::function<void()> task);
+
+    // runs body(state, index) for every index in [0, count), each task creates
+    // its own state with init() and keeps pulling indices until none are left;
+    // blocks until done and rethrows the first exception thrown by a task.
+    // called from inside a task of the same pool it runs inline on the calling
+    // worker, waiting for queued tasks there could leave no worker to run them
+    template<typename Init, typename Body>
+    void parallel_for(std::size_t count, Init&& init, Body&& body) {
+	if(count == 0) {
+	    return;
+	}
+
+	if(on_worker()) {
+	    auto state = init();
+	    for(std::size_t index = 0; index < count; ++index) {
+		body(state, index);
+	    }
+	    return;
+	}
+
+	std::size_t tasks = std::min(count, size());
+	std::atomic<std::size_t> next{};
+	std::latch done{static_cast<std::ptrdiff_t>(tasks)};
+	std::exception_ptr error{};
+	std::mutex error_lock{};
+
+	for(std::size_t task = 0; task < tasks; ++task) {
+	    submit([&] {
+		try {
+		    auto state = init();
+		    for(std::size_t index = next++; index < count; index = next++) {
+			body(state, index);
+		    }
+		} catch(...) {
+		    std::scoped_lock guard{error_lock};
+		    if(!error) {
+			error = std::current_exception();
+		    }
+		    next = count;
+		}
+		done.count_down();
+	    });
+	}
+
+	done.wait();
+	if(error) {
+	    std::rethrow_exception(error);
+	}
+    }
+
+    template<typename Body>
+    void parallel_for(std::size_t count, Body&& body) {
+	parallel_for(count, [] { return 0; }, [&body] (int /*state*/, std::size_t index) { body(index); });
+    }
+};
@@ -2,40 +2,133 @@
 
 #include <any_tree.hpp>
 #include <functional>
+#include <optional>
 #include <nlohmann/json.hpp>
+#include <llvm/IR/DataLayout.h>
 #include <ratio>
 
 #include "any_tree/node.hpp"
+#include "fp_flags.hpp"
 #include "type/type_id.hpp"
+#include "type/interner.hpp"
 #include "type/registry.hpp"
 #include "functions.hpp"
+#include "thread_pool.hpp"
 
 
+// "pos": {"line": 3, "column": 5} in the source the json was parsed from, 0 when not given
+struct source_position {
+    unsigned line;
+    unsigned column;
+};
+
+// properties proven by attribute_inference, all false means nothing is known
+struct function_attributes {
+    // memory(none)
+    bool pure;
+    bool nounwind;
+    bool norecurse;
+    bool willreturn;
+};
+
 struct function_info {
     std::string name;
     std::vector<std::string> params;
     std::vector<type::type_id> params_type;
     type::type_id return_type;
+    function_attributes attributes;
+    // keeps external linkage, see export_policy
+    bool exported;
+    // position in the file, set by semantic analysis
+    std::size_t index;
+    // "funcFastMath", replaces the command line flags for this function
+    std::optional<fp_flags> fast_math;
+    // "funcHot" or "funcCold", unset when nothing is known about how often it runs
+    std::optional<bool> hot;
+    source_position position;
 };
 
 struct var_def_info {
     std::string name;
     type::type_id type;
+    source_position position;
 };
 
 struct binary_expr_info {
     std::string oper;
     type::type_id lhs;
     type::type_id rhs;
+    // of the whole expression the operator was resolved from
+    source_position position;
 };
 
 struct call_info {
     std::string callee;
     type::type_id type;
+    // position of the callee in the file, set by semantic analysis
+    std::size_t callee_index;
+    // set instead of the index when the callee is provided by the compiler
+    const builtin_function::overload* builtin;
+    source_position position;
 };
 
 struct if_info {
     bool has_let;
+    // "likely" or "unlikely" on the then branch, unset when the source says nothing
+    std::optional<bool> likely{};
+    source_position position{};
+};
+
+// an if used as a value, a type of its own so visitors can tell it from the statement
+struct if_expr_info : if_info {};
+
+// optimizer hints from the source, unset ones are left to the optimizer
+struct loop_info {
+    std::optional<bool> unroll;
+    unsigned unroll_count;
+    std::optional<bool> vectorize;
+    unsigned vectorize_width;
+    // whether the body is entered, or how many times on average, 0 when unknown
+    std::optional<bool> likely;
+    unsigned expected_trip_count;
+    source_position position;
+};
+
+// "[e0, e1, ...]", type is the array type once known, sema may get it from a declaration
+struct array_info {
+    type::type_id type;
+};
+
+// "indexed[index]", the index is extended to 64 bits before the element address is computed
+struct index_info {
+    type::type_id array;
+    type::type_id element;
+    std::size_t length;
+    bool signed_index;
+};
+
+// "Name { field: value, ... }", members maps every child to its place in the struct
+struct struct_literal_info {
+    std::string name;
+    std::vector<std::string> fields;
+    type::type_id type;
+    std::vector<std::size_t> members;
+};
+
+// "accessed.field", index is the member position after layout
+struct field_info {
+    std::string name;
+    type::type_id type;
+    std::size_t index;
+    type::type_id member;
+};
+
+// sizes of a declared struct, in source order and as laid out
+struct struct_layout {
+    std::string name;
+    type::type_id type;
+    std::size_t declared_size;
+    std::size_t size;
 };
 
 template<typename T>
@@ -55,14 +148,20 @@ using block_node	    = any_tree::dynamic_node<void, 2>;
 using var_def_node          = any_tree::dynamic_node<var_def_info>;
 using call_node             = any_tree::dynamic_node<call_info>;
 using function_node         = any_tree::static_node<function_info, 1>;
-using return_statement_node = any_tree::static_node<void, 1>;
+using return_statement_node = any_tree::static_node<source_position, 1>;
 using binary_expr_node      = any_tree::static_node<binary_expr_info, 2>;
 // ifs
 using if_node               = any_tree::static_node<if_info, 3>;
 using if_else_node          = any_tree::static_node<if_info, 4>;
-using if_else_expr_node     = any_tree::static_node<if_info, 4>;
+using if_else_expr_node     = any_tree::static_node<if_expr_info, 4>;
 // loops
-using loop_node             = any_tree::static_node<void, 4>;
+using loop_node             = any_tree::static_node<loop_info, 4>;
+// arrays
+using array_literal_node    = any_tree::dynamic_node<array_info>;
+using index_node            = any_tree::static_node<index_info, 2>;
+// structs
+using struct_literal_node   = any_tree::dynamic_node<struct_literal_info>;
+using field_node            = any_tree::static_node<field_info, 1>;
 
 using identifier_node       = any_tree::leaf<std::string>;
 // literals
@@ -74,11 +173,18 @@ using bool_literal_node     = any_tree::leaf<literal<bool>>;
 
 using implicit_cast_node = any_tree::static_node<cast_info, 1>;
 
+// the tree builder only puts functions in a file, its children are read as
+// function_node here instead of casting and checking each one where it is used
+inline auto function_at(file_node& node, std::size_t index) -> function_node& {
+    return *std::any_cast<function_node>(&node.children()[index]);
+}
+
 using json = nlohmann::json;
 
 class tree_builder {
-    special_functions* _special;
-    type::registry* _types;
+    const special_functions* _special;
+    type::interner* _types;
+    thread_pool* _pool;
 
     auto file(const json& object)        -> file_node;
     auto function(const json& object)    -> function_node;
@@ -93,27 +199,31 @@ class tree_builder {
     auto loop(const json& object)        -> loop_node;
     auto call(const json& object)        -> call_node;
     auto block(const json& object)       -> block_node;
+    auto array(const json& object)       -> array_literal_node;
+    auto index(const json& object)       -> index_node;
+    auto struct_literal(const json& object) -> struct_literal_node;
+    auto field(const json& object)       -> field_node;
+
+    // type names plus "[T; N]" for arrays
+    auto parse_type(const std::string& name) -> type::type_id;
 
     static auto literal(const json& object)  -> std::any;
+    // "likely": true or "unlikely": true on ifs and loops
+    static auto branch_hint(const json& object) -> std::optional<bool>;
+    static auto position(const json& object) -> source_position;
 
     inline auto function_hander()    { return std::bind_front(&tree_builder::function, this); }
     inline auto stmt_hander()        { return std::bind_front(&tree_builder::stmt, this); }
-    inline auto return_stmt_hander() { return std::bind_front(&tree_builder::return_stmt, this); }
-    inline auto let_stmt_hander()    { return std::bind_front(&tree_builder::let_stmt, this); }
     inline auto var_def_hander()     { return std::bind_front(&tree_builder::var_def, this); }
     inline auto expr_hander()        { return std::bind_front(&tree_builder::expr, this); }
-    inline auto if_handler()         { return std::bind_front(&tree_builder::if_stmt, this); }
-    inline auto if_expr_handler()    { return std::bind_front(&tree_builder::if_expr, this); }
-    inline auto loop_hander()        { return std::bind_front(&tree_builder::loop, this); }
-    inline auto call_hander()        { return std::bind_front(&tree_builder::call, this); }
-    inline auto block_hander()       { return std::bind_front(&tree_builder::block, this); }
 
-    auto operator_resolution(std::span<std::any> primaries, std::span<std::string> ops) -> std::any;
+    auto operator_resolution(std::span<std::any> primaries, std::span<std::string> ops, source_position position) -> std::any;
 
 public:
-    tree_builder(special_functions* special, type::registry* types)
+    tree_builder(const special_functions* special, type::interner* types, thread_pool* pool = nullptr)
 	: _special{special}
 	, _types{types}
+	, _pool{pool}
     {}
 
     tree_builder()                      = delete;
@@ -125,6 +235,18 @@ public:
 
 
     inline auto operator()(const json& object) -> std::any { return file(object); }
+
+    // "structs" of a file, has to run before any function is built since
+    // signatures and bodies refer to structs by name. with reorder, or
+    // "structReorder" on a struct, hot fields come first and fields are
+    // sorted by alignment to minimize padding. empty when a struct or field
+    // name repeats or a field type is unknown or declared later. sizes and
+    // alignments are data_layout's for the llvm types the registry lowers to
+    auto declare_structs(const json& object, type::registry& types, const llvm::DataLayout& data_layout, bool reorder = false) -> std::optional<std::vector<struct_layout>>;
+
+    // pieces of a file for callers that stream functions one by one
+    auto signature(const json& object) -> function_info;
+    auto build_function(const json& object) -> std::any { return function(object); }
 };
 
 auto insert_implicit_cast(std::any&& node, type::type_id from_type, type::type_id to_type) -> std::any;
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "type_id.hpp"
+#include "../hash.hpp"
+
+
+namespace type {
+
+enum class kind : std::uint8_t {
+    none,
+    primitive,
+    structure,
+    anon_structure,
+    function,
+    array,
+};
+
+// LLVM independent shape of an interned type
+class descriptor {
+public:
+    using fields_type = std::vector<std::pair<std::string, type_id>>;
+
+private:
+    kind _kind{kind::none};
+    std::vector<type_id> _members{};
+    std::vector<std::string> _fields{};
+    std::string _name{};
+    type_id _element{};
+    std::size_t _length{};
+
+public:
+    explicit descriptor(kind kind) noexcept : _kind{kind} {}
+
+    descriptor(kind kind, std::vector<type_id> members, type_id element = {}, std::size_t length = {}) noexcept
+	: _kind{kind}
+	, _members{std::move(members)}
+	, _element{element}
+	, _length{length}
+    {}
+
+    descriptor(std::string name, const fields_type& fields)
+	: _kind{kind::structure}
+	, _name{std::move(name)}
+    {
+	_members.reserve(fields.size());
+	_fields.reserve(fields.size());
+	for(const auto& [field, tid] : fields) {
+	    _fields.push_back(field);
+	    _members.push_back(tid);
+	}
+    }
+
+    descriptor()                                     = default;
+    descriptor(const descriptor&)                    = delete;
+    descriptor(descriptor&&)                         = default;
+    auto operator=(const descriptor&) -> descriptor& = delete;
+    auto operator=(descriptor&&) -> descriptor&      = default;
+    ~descriptor()                                    = default;
+
+    auto get_kind() const noexcept -> kind { return _kind; }
+
+    auto members()     const noexcept -> std::span<const type_id> { return _members; }
+    auto params()      const noexcept -> std::span<const type_id> { return _members; }
+    auto fields()      const noexcept -> const auto& { return _fields; }
+    auto name()        const noexcept -> const std::string& { return _name; }
+    auto return_type() const noexcept -> type_id { return _element; }
+    auto element()     const noexcept -> type_id { return _element; }
+    auto length()      const noexcept -> std::size_t { return _length; }
+};
+
+// append-only storage with stable addresses, an element may be read without
+// locking once its index has been published to the reading thread
+template<typename T>
+class segmented_storage {
+    // first segment holds 256 elements, every next one doubles
+    static constexpr std::size_t first_bits = 8;
+    static constexpr std::size_t segments   = 48;
+
+    std::array<std::atomic<T*>, segments> _segments{};
+
+    static constexpr auto segment_size(std::size_t segment) noexcept -> std::size_t {
+	return std::size_t{1} << (segment + first_bits);
+    }
+
+    static constexpr auto locate(std::size_t index) noexcept -> std::pair<std::size_t, std::size_t> {
+	std::size_t biased = index + segment_size(0);
+	std::size_t segment = std::bit_width(biased) - 1 - first_bits;
+	return {segment, biased - segment_size(segment)};
+    }
+
+public:
+    segmented_storage()                                            = default;
+    segmented_storage(const segmented_storage&)                    = delete;
+    segmented_storage(segmented_storage&&)                         = delete;
+    auto operator=(const segmented_storage&) -> segmented_storage& = delete;
+    auto operator=(segmented_storage&&) -> segmented_storage&      = delete;
+
+    ~segmented_storage() {
+	for(auto& segment : _segments) {
+	    delete[] segment.load(std::memory_order_relaxed);
+	}
+    }
+
+    // may be called concurrently as long as indices are distinct
+    auto slot(std::size_t index) -> T& {
+	auto [segment, offset] = locate(index);
+
+	T* data = _segments[segment].load(std::memory_order_acquire);
+	if(data == nullptr) {
+	    auto fresh = std::make_unique<T[]>(segment_size(segment));
+	    if(_segments[segment].compare_exchange_strong(data, fresh.get(), std::memory_order_acq_rel)) {
+		data = fresh.release();
+	    }
+	}
+	return data[offset];
+    }
+
+    auto operator[](std::size_t index) const noexcept -> const T& {
+	auto [segment, offset] = locate(index);
+	return _segments[segment].load(std::memory_order_acquire)[offset];
+    }
+
+    auto operator[](std::size_t index) noexcept -> T& {
+	auto [segment, offset] = locate(index);
+	return _segments[segment].load(std::memory_order_acquire)[offset];
+    }
+};
+
+// hash -> handle index split into shards, probing is lock-free and
+// insertion takes the lock of a single shard
+class sharded_index {
+    static constexpr std::size_t shard_bits       = 6;
+    static constexpr std::size_t shard_count      = std::size_t{1} << shard_bits;
+    static constexpr std::size_t initial_capacity = 16;
+
+    // slot layout: low 32 bits of the hash << 32 | handle + 1, zero is empty
+    struct table {
+	std::size_t mask;
+	std::unique_ptr<std::atomic<std::uint64_t>[]> slots;
+
+	explicit table(std::size_t capacity)
+	    : mask{capacity - 1}
+	    , slots{std::make_unique<std::atomic<std::uint64_t>[]>(capacity)}
+	{}
+    };
+
+    struct alignas(64) shard {
+	std::atomic<table*> current{};
+	std::mutex lock{};
+	std::size_t size{};
+	// replaced tables stay alive, readers may still be probing them
+	std::vector<std::unique_ptr<table>> tables{};
+    };
+
+    std::array<shard, shard_count> _shards{};
+
+    static constexpr auto tag(std::uint64_t hash) noexcept -> std::uint64_t {
+	return hash & 0xffffffffULL;
+    }
+
+    auto shard_for(std::uint64_t hash) noexcept -> shard& {
+	return _shards[hash >> (64 - shard_bits)];
+    }
+
+    auto shard_for(std::uint64_t hash) const noexcept -> const shard& {
+	return _shards[hash >> (64 - shard_bits)];
+    }
+
+    template<typename Equal>
+    static auto probe(const table& tbl, std::uint64_t hash, Equal& equal) -> std::optional<std::uint32_t> {
+	for(std::size_t index = tag(hash) & tbl.mask;; index = (index + 1) & tbl.mask) {
+	    std::uint64_t value = tbl.slots[index].load(std::memory_order_acquire);
+	    if(value == 0) {
+		return {};
+	    }
+
+	    auto handle = static_cast<std::uint32_t>(tag(value) - 1);
+	    if((value >> 32U) == tag(hash) && equal(handle)) {
+		return handle;
+	    }
+	}
+    }
+
+    static void place(table& tbl, std::uint64_t hash, std::uint32_t handle) noexcept {
+	std::size_t index = tag(hash) & tbl.mask;
+	while(tbl.slots[index].load(std::memory_order_relaxed) != 0) {
+	    index = (index + 1) & tbl.mask;
+	}
+	tbl.slots[index].store((tag(hash) << 32U) | (std::uint64_t{handle} + 1), std::memory_order_release);
+    }
+
+    static auto grow(shard& owner) -> table*;
+
+public:
+    sharded_index();
+
+    sharded_index(const sharded_index&)                    = delete;
+    sharded_index(sharded_index&&)                         = delete;
+    auto operator=(const sharded_index&) -> sharded_index& = delete;
+    auto operator=(sharded_index&&) -> sharded_index&      = delete;
+    ~sharded_index()                                       = default;
+
+    template<typename Equal>
+    auto find(std::uint64_t hash, Equal&& equal) const -> std::optional<std::uint32_t> {
+	return probe(*shard_for(hash).current.load(std::memory_order_acquire), hash, equal);
+    }
+
+    // make() is called under the shard lock and only when the key is missing
+    template<typename Equal, typename Make>
+    auto insert(std::uint64_t hash, Equal&& equal, Make&& make) -> std::uint32_t {
+	shard& owner = shard_for(hash);
+	std::scoped_lock guard{owner.lock};
+
+	table* current = owner.current.load(std::memory_order_relaxed);
+	if(auto found = probe(*current, hash, equal); found.has_value()) {
+	    return *found;
+	}
+
+	if((owner.size + 1) * 2 > current->mask + 1) {
+	    current = grow(owner);
+	}
+
+	std::uint32_t handle = make();
+	place(*current, hash, handle);
+	++owner.size;
+	return handle;
+    }
+};
+
+// thread-safe hash-consing of types, ids are stable and shared by every
+// registry built on top of the same interner
+class interner {
+    struct name_record {
+	std::string name{};
+	std::atomic<type_id> tid{};
+    };
+
+    segmented_storage<descriptor> _types{};
+    segmented_storage<name_record> _names{};
+
+    sharded_index _type_index{};
+    sharded_index _name_index{};
+
+    // ids handed out and ids whose descriptor is written, see allocate()
+    std::atomic<std::uint64_t> _next_type{static_cast<std::uint64_t>(type_id::primitive_bound) + 1};
+    std::atomic<std::uint64_t> _published_types{static_cast<std::uint64_t>(type_id::primitive_bound) + 1};
+    std::atomic<std::uint32_t> _next_name{};
+
+    auto allocate(descriptor&& desc) -> std::uint32_t;
+
+public:
+    interner();
+
+    interner(const interner&)                    = delete;
+    interner(interner&&)                         = delete;
+    auto operator=(const interner&) -> interner& = delete;
+    auto operator=(interner&&) -> interner&      = delete;
+    ~interner()                                  = default;
+
+    [[nodiscard]] auto id(std::string_view name) const noexcept -> type_id;
+
+    [[nodiscard]] auto id(std::span<const type_id> members)             noexcept -> type_id;
+    [[nodiscard]] auto id(std::span<const type_id> params, type_id ret) noexcept -> type_id;
+    [[nodiscard]] auto id(type_id elements, std::size_t size)           noexcept -> type_id;
+
+    [[nodiscard]] auto describe(type_id tid)        const noexcept -> const descriptor*;
+    [[nodiscard]] auto get_struct(type_id tid)      const noexcept -> const descriptor*;
+    [[nodiscard]] auto get_anon_struct(type_id tid) const noexcept -> const descriptor*;
+    [[nodiscard]] auto get_function(type_id tid)    const noexcept -> const descriptor*;
+    [[nodiscard]] auto get_array(type_id tid)       const noexcept -> const descriptor*;
+
+    [[nodiscard]] auto make_struct(const std::string& name, const descriptor::fields_type& fields) noexcept -> type_id;
+
+    void make_alias(const std::string& alias, type_id tid) noexcept;
+
+    [[nodiscard]] auto size() const noexcept -> std::size_t { return _published_types.load(std::memory_order_acquire); }
+};
+
+} // namespace type
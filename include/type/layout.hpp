@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+
+#include <llvm/IR/DataLayout.h>
+
+#include "type_id.hpp"
+#include "registry.hpp"
+
+
+namespace type {
+
+struct layout {
+    std::size_t size;
+    std::size_t align;
+};
+
+// size and ABI alignment of the type the registry lowers tid to, as the
+// module's DataLayout places it, so fields are ordered for the actual target
+auto layout_of(const registry& types, const llvm::DataLayout& data_layout, type_id tid) noexcept -> std::optional<layout>;
+
+// members placed one after another in the given order, padding included
+auto layout_of(registry& types, const llvm::DataLayout& data_layout, std::span<const type_id> members) noexcept -> std::optional<layout>;
+
+} // namespace type
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
 #include <functional>
-#include <unordered_map>
+#include <memory>
+#include <span>
 #include <vector>
 #include <optional>
 
@@ -9,36 +12,38 @@
 
 #include "type_id.hpp"
 #include "type.hpp"
+#include "interner.hpp"
 #include "array_type.hpp"
 #include "anon_struct_type.hpp"
 #include "struct_type.hpp"
 #include "function_type.hpp"
-#include "../hash.hpp"
 
 
 namespace type {
 
+// LLVM side of the types handed out by an interner, one registry per LLVMContext.
+// Types are materialized lazily, so ids interned by other threads can be used
+// here, but the registry itself must only be used from its context's thread.
 class registry {
-    using anon_struct_key = std::vector<type_id>;
-    using array_key       = std::pair<type_id, std::size_t>;
-    using function_key    = std::pair<std::vector<type_id>, type_id>;
-
-    using anon_struct_hash = hash_for_t<anon_struct_key>;
-    using array_hash       = hash_for_t<array_key>;
-    using function_hash    = hash_for_t<function_key>;
+    // one entry per type_id, index points into the storage of the matching kind
+    struct entry {
+	kind tag{kind::none};
+	llvm::Type* type{};
+	std::uint32_t index{};
+    };
 
     llvm::LLVMContext* _context;
 
-    std::unordered_map<std::string, type_id> _names;
-    std::unordered_map<anon_struct_key, type_id, anon_struct_hash> _anon_struct_ids;
-    std::unordered_map<array_key, type_id, array_hash> _array_ids;
-    std::unordered_map<function_key, type_id, function_hash> _function_ids;
+    std::unique_ptr<interner> _owned_interner{};
+    interner* _interner;
+
+    mutable std::vector<entry> _entries;
 
-    std::unordered_map<type_id, type> _primitives;
-    std::unordered_map<type_id, function_type> _functions;
-    std::unordered_map<type_id, array_type> _arrays;
-    std::unordered_map<type_id, struct_type> _structs;
-    std::unordered_map<type_id, anon_struct_type> _anon_structs;
+    // deques keep references stable, types themselves are not movable
+    mutable std::deque<function_type> _functions;
+    mutable std::deque<array_type> _arrays;
+    mutable std::deque<struct_type> _structs;
+    mutable std::deque<anon_struct_type> _anon_structs;
 
 public:
     registry()                                   = delete;
@@ -48,15 +53,28 @@ public:
     auto operator=(registry&&) -> registry&      = delete;
     ~registry()				         = default;
 
-    explicit registry(llvm::LLVMContext* context) : _context{context} {
+    explicit registry(llvm::LLVMContext* context)
+	: _context{context}
+	, _owned_interner{std::make_unique<interner>()}
+	, _interner{_owned_interner.get()}
+    {
+	make_primitives();
+    }
+
+    registry(llvm::LLVMContext* context, interner* types)
+	: _context{context}
+	, _interner{types}
+    {
 	make_primitives();
     }
 
-    [[nodiscard]] auto id(const std::string& name) const noexcept -> type_id;
+    [[nodiscard]] auto get_interner() const noexcept -> interner* { return _interner; }
+
+    [[nodiscard]] auto id(const std::string& name) const noexcept -> type_id { return _interner->id(name); }
 
-    [[nodiscard]] auto id(const std::vector<type_id>& members)             noexcept -> type_id;
-    [[nodiscard]] auto id(const std::vector<type_id>& params, type_id ret) noexcept -> type_id;
-    [[nodiscard]] auto id(type_id elements, std::size_t size)              noexcept -> type_id;
+    [[nodiscard]] auto id(std::span<const type_id> members)             noexcept -> type_id { return _interner->id(members); }
+    [[nodiscard]] auto id(std::span<const type_id> params, type_id ret) noexcept -> type_id { return _interner->id(params, ret); }
+    [[nodiscard]] auto id(type_id elements, std::size_t size)           noexcept -> type_id { return _interner->id(elements, size); }
 
     [[nodiscard]] auto get(type_id tid)             const noexcept -> std::optional<type>;
     [[nodiscard]] auto get_struct(type_id tid)	    const noexcept -> const struct_type*;
@@ -70,17 +88,17 @@ public:
     [[nodiscard]] auto get_array(const std::string& name)    const noexcept -> const array_type*;
 
     [[nodiscard]] auto make_struct(const std::string& name, const struct_type::members_type& members) noexcept -> const struct_type&;
-    [[nodiscard]] auto make_anon_struct(const std::vector<type_id>& members)                          noexcept -> const anon_struct_type&;
-    [[nodiscard]] auto make_function(const std::vector<type_id>& params, type_id ret)                 noexcept -> const function_type&;
+    [[nodiscard]] auto make_anon_struct(std::span<const type_id> members)                             noexcept -> const anon_struct_type&;
+    [[nodiscard]] auto make_function(std::span<const type_id> params, type_id ret)                    noexcept -> const function_type&;
     [[nodiscard]] auto make_array(type_id elements, std::size_t size)                                 noexcept -> const array_type&;
 
-    void make_alias(const std::string& alias, type_id tid) noexcept { _names[alias] = tid; }
+    void make_alias(const std::string& alias, type_id tid) noexcept { _interner->make_alias(alias, tid); }
 
 private:
-    static auto next_id() noexcept -> type_id {
-	static type_id tid{type_id::primitive_bound};
-	return ++tid;
-    }
+    [[nodiscard]] auto find(type_id tid, kind expected) const noexcept -> const entry*;
+
+    auto materialize(type_id tid) const noexcept -> const entry*;
+    auto lower_all(std::span<const type_id> tids) const noexcept -> std::vector<llvm::Type*>;
 
     void make_primitives() noexcept;
 };
@@ -31,6 +31,17 @@ enum class type_id : std::uint64_t {
     i64,
     fp32,
     fp64,
+    // SIMD vectors and the masks their comparisons produce
+    f32x4,
+    f32x8,
+    i32x4,
+    i32x8,
+    u8x16,
+    mask4,
+    mask8,
+    mask16,
+    // read-only byte slice, a pointer and a length
+    str,
     primitive_bound,
 };
 
@@ -47,6 +58,14 @@ constexpr inline auto is_literal(type_id tid) -> bool {
     return type_id::u_literal <= tid && tid < type_id::literal_bound;
 }
 
+constexpr inline auto is_integer(type_id tid) -> bool {
+    return type_id::u8 <= tid && tid <= type_id::i64;
+}
+
+constexpr inline auto is_signed(type_id tid) -> bool {
+    return type_id::i8 <= tid && tid <= type_id::i64;
+}
+
 constexpr inline auto default_type(type_id tid) -> type_id {
     switch(tid) {
 	case type_id::u_literal:
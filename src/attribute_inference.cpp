@@ -0,0 +1,45 @@
+#include <algorithm>
+
+#include "attribute_inference.hpp"
+#include "call_graph.hpp"
+
+
+void infer_attributes(file_node& node, bool may_trap, bool bounds_checks) {
+    call_graph graph{node};
+
+    // components come out callees first, so every callee outside of the
+    // component being processed already has its attributes
+    std::vector<function_attributes> attributes(graph.size());
+    for(const std::vector<std::size_t>& component : graph.strongly_connected()) {
+	auto front_callees = graph.callees(component.front());
+	bool recursive = component.size() > 1 || std::ranges::find(front_callees, component.front()) != front_callees.end();
+
+	bool pure = !may_trap;
+	bool nounwind = true;
+	bool willreturn = !recursive && !may_trap;
+
+	for(std::size_t index : component) {
+	    bool traps = bounds_checks && graph.has_index(index);
+	    pure = pure && !traps && !graph.calls_unknown(index);
+	    nounwind = nounwind && !graph.calls_unknown(index);
+	    willreturn = willreturn && !traps && !graph.calls_unknown(index) && !graph.has_loop(index);
+
+	    for(std::size_t callee : graph.callees(index)) {
+		if(std::ranges::find(component, callee) != component.end()) {
+		    continue;
+		}
+		pure = pure && attributes[callee].pure;
+		nounwind = nounwind && attributes[callee].nounwind;
+		willreturn = willreturn && attributes[callee].willreturn;
+	    }
+	}
+
+	for(std::size_t index : component) {
+	    attributes[index] = {pure, nounwind, !recursive, willreturn};
+	}
+    }
+
+    for(std::size_t index = 0; index < node.children_size(); ++index) {
+	std::any_cast<function_node&>(node.children()[index]).payload().attributes = attributes[index];
+    }
+}
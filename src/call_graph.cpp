@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "call_graph.hpp"
+
+
+auto call_graph::strongly_connected() const -> std::vector<std::vector<std::size_t>> {
+    constexpr std::size_t unvisited = std::numeric_limits<std::size_t>::max();
+
+    // Tarjan's algorithm
+    std::vector<std::size_t> order(_facts.size(), unvisited);
+    std::vector<std::size_t> low(_facts.size());
+    std::vector<bool> on_stack(_facts.size());
+    std::vector<std::size_t> stack{};
+    std::vector<std::vector<std::size_t>> components{};
+    std::size_t counter{};
+
+    std::function<void(std::size_t)> connect = [&] (std::size_t index) {
+	order[index] = low[index] = counter++;
+	stack.push_back(index);
+	on_stack[index] = true;
+
+	for(std::size_t callee : _facts[index].callees) {
+	    if(order[callee] == unvisited) {
+		connect(callee);
+		low[index] = std::min(low[index], low[callee]);
+	    } else if(on_stack[callee]) {
+		low[index] = std::min(low[index], order[callee]);
+	    }
+	}
+
+	if(low[index] != order[index]) {
+	    return;
+	}
+
+	std::vector<std::size_t>& component = components.emplace_back();
+	std::size_t member{};
+	do {
+	    member = stack.back();
+	    stack.pop_back();
+	    on_stack[member] = false;
+	    component.push_back(member);
+	} while(member != index);
+    };
+
+    for(std::size_t index = 0; index < _facts.size(); ++index) {
+	if(order[index] == unvisited) {
+	    connect(index);
+	}
+    }
+
+    return components;
+}
+
+auto call_graph::reachable(std::span<const std::size_t> roots) const -> std::vector<bool> {
+    std::vector<bool> seen(_facts.size());
+    std::vector<std::size_t> work{roots.begin(), roots.end()};
+
+    while(!work.empty()) {
+	std::size_t index = work.back();
+	work.pop_back();
+	if(seen[index]) {
+	    continue;
+	}
+
+	seen[index] = true;
+	std::ranges::copy_if(_facts[index].callees, std::back_inserter(work), [&seen] (std::size_t callee) { return !seen[callee]; });
+    }
+
+    return seen;
+}
+
+call_graph::call_graph(const file_node& node) {
+    auto descend = [this] (const auto& node) {
+	node.for_each_child([this] (const std::any& child) { any_tree::visit_node(_visitor, child); });
+    };
+    auto leaf = [] (const auto&) {};
+
+    _visitor = {
+	any_tree::make_const_child_visitor<return_statement_node>(descend),
+	any_tree::make_const_child_visitor<let_statement_node>   (descend),
+	any_tree::make_const_child_visitor<var_def_node>         (descend),
+	any_tree::make_const_child_visitor<binary_expr_node>     (descend),
+	any_tree::make_const_child_visitor<if_node>              (descend),
+	any_tree::make_const_child_visitor<if_else_node>         (descend),
+	any_tree::make_const_child_visitor<if_else_expr_node>    (descend),
+	any_tree::make_const_child_visitor<block_node>           (descend),
+	any_tree::make_const_child_visitor<implicit_cast_node>   (descend),
+	any_tree::make_const_child_visitor<array_literal_node>   (descend),
+	any_tree::make_const_child_visitor<struct_literal_node>  (descend),
+	any_tree::make_const_child_visitor<field_node>           (descend),
+	any_tree::make_const_child_visitor<index_node>           ([this, descend] (const index_node& node) {
+		_current->has_index = true;
+		descend(node);
+	}),
+	any_tree::make_const_child_visitor<loop_node>            ([this, descend] (const loop_node& node) {
+		_current->has_loop = true;
+		descend(node);
+	}),
+	any_tree::make_const_child_visitor<call_node>            ([this, descend] (const call_node& node) {
+		// builtins have no side effects and always return
+		if(node.payload().builtin != nullptr) {
+		    descend(node);
+		    return;
+		}
+
+		if(auto iter = _indices.find(node.payload().callee); iter != _indices.end()) {
+		    _current->callees.push_back(iter->second);
+		} else {
+		    _current->calls_unknown = true;
+		}
+		descend(node);
+	}),
+	any_tree::make_const_child_visitor<identifier_node>      (leaf),
+	any_tree::make_const_child_visitor<integer_literal_node> (leaf),
+	any_tree::make_const_child_visitor<floating_literal_node>(leaf),
+	any_tree::make_const_child_visitor<char_literal_node>    (leaf),
+	any_tree::make_const_child_visitor<string_literal_node>  (leaf),
+	any_tree::make_const_child_visitor<bool_literal_node>    (leaf),
+	any_tree::make_const_child_visitor<void>                 ([] () {}),
+    };
+
+    _facts.resize(node.children_size());
+    for(std::size_t index = 0; index < node.children_size(); ++index) {
+	_indices.emplace(std::any_cast<const function_node&>(node.children()[index]).payload().name, index);
+    }
+
+    for(std::size_t index = 0; index < node.children_size(); ++index) {
+	_current = &_facts[index];
+	any_tree::visit_node(_visitor, std::any_cast<const function_node&>(node.children()[index]).child_at(0));
+    }
+    _current = nullptr;
+}
@@ -1,14 +1,23 @@
 #include <algorithm>
 #include <iostream>
 
+#include <llvm/BinaryFormat/Dwarf.h>
 #include <llvm/IR/Argument.h>
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/CallingConv.h>
+#include <llvm/IR/Constants.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Support/Path.h>
 
 #include "any_tree/visitor.hpp"
 #include "code_generator.hpp"
@@ -21,9 +30,26 @@ auto entry_builder(llvm::Function* func) -> llvm::IRBuilder<> {
     return llvm::IRBuilder<>{&func->getEntryBlock(), func->getEntryBlock().begin()};
 }
 
+auto fast_math_flags(fp_flags flags) -> llvm::FastMathFlags {
+    llvm::FastMathFlags result{};
+    result.setAllowReassoc   (has(flags, fp_flags::reassoc));
+    result.setAllowContract  (has(flags, fp_flags::contract));
+    result.setNoNaNs         (has(flags, fp_flags::no_nans));
+    result.setNoInfs         (has(flags, fp_flags::no_infs));
+    result.setAllowReciprocal(has(flags, fp_flags::arcp));
+    result.setNoSignedZeros  (has(flags, fp_flags::no_signed_zeros));
+    result.setApproxFunc     (has(flags, fp_flags::approx_func));
+    return result;
+}
+
 auto code_generator::file(const visitor& visitor, const file_node& node) -> llvm::Value* {
     std::cout << "file" << std::endl;
 
+    // every prototype exists before the first body, calls may go in any direction
+    for(const std::any& child : node.children()) {
+	declare(std::any_cast<const function_node&>(child).payload());
+    }
+
     std::vector<llvm::Value*> functions{};
     functions.reserve(node.children_size());
 
@@ -47,51 +73,181 @@ auto code_generator::file(const visitor& visitor, const file_node& node) -> llvm
 
 auto code_generator::function(const visitor& visitor, const function_node& node) -> llvm::Value* {
     std::cout << "function" << std::endl;
-    llvm::FunctionType* func_type = *_types->make_function(node.payload().params_type, node.payload().return_type);
-    llvm::Function* func = llvm::Function::Create(
-	    func_type, 
-	    llvm::Function::ExternalLinkage,
-	    node.payload().name,
-	    _module
-    );
-
-    auto param = node.payload().params.begin();
-    for(llvm::Argument& arg: func->args()) {
-	arg.setName(*param++);
+    if(node.payload().index >= _prototypes.size()) {
+	return nullptr;
     }
+    llvm::Function* func = _prototypes[node.payload().index];
 
-    _functions.add(node.payload().name, func);
     scope_pusher pusher{&_scope, func};
 
+    // the prologue is attributed to the function's own line
+    _subprogram = _debug != nullptr ? subprogram(node.payload(), func) : nullptr;
+    location_pusher location{this, node.payload().position};
+
+    // floating point inserters pick these up from the builder
+    _builder.setFastMathFlags(fast_math_flags(node.payload().fast_math.value_or(_options.fast_math)));
+
     llvm::BasicBlock* block = llvm::BasicBlock::Create(*_context, "entry", func);
     _builder.SetInsertPoint(block);
 
+    _params.clear();
     for(auto& arg: func->args()) {
-	llvm::AllocaInst* inst = _builder.CreateAlloca(arg.getType(), nullptr, arg.getName());
+	ssa_builder::variable* var = make_variable(std::string{arg.getName()}, arg.getType());
+	write_variable(var, &arg);
 
-	_builder.CreateStore(&arg, inst);
+	_scope.add(var->name, var);
+	_params.push_back(var);
+    }
 
-	_scope.add(std::string{arg.getName()}, inst);
+    // self tail calls jump back here with new parameter values
+    if(_options.tail_loops) {
+	_tail_header = llvm::BasicBlock::Create(*_context, "tail_header", func);
+	_builder.CreateBr(_tail_header);
+	_ssa.unseal(_tail_header);
+	_builder.SetInsertPoint(_tail_header);
     }
 
     llvm::Value* block_result = any_tree::visit_node(visitor, node.child_at(0));
+
+    if(_tail_header != nullptr) {
+	_ssa.seal(_tail_header);
+	_tail_header = nullptr;
+    }
+    _ssa.clear();
+
     if(block_result == nullptr) {
 	return nullptr;
     }
 
+    // e.g. the merge block of an if whose branches both return
+    if(llvm::BasicBlock* last = _builder.GetInsertBlock(); last->getTerminator() == nullptr && llvm::pred_empty(last)) {
+	_builder.CreateUnreachable();
+    }
+
     if(llvm::verifyFunction(*func, &llvm::errs())) {
-	func->eraseFromParent();
+	// the prototype stays, other functions may already call it
+	func->deleteBody();
 	return nullptr;
     }
 
     return func;
 }
 
+auto code_generator::declare(const function_info& info) -> llvm::Function* {
+    llvm::FunctionType* func_type = *_types->make_function(info.params_type, info.return_type);
+    llvm::Function* func = llvm::Function::Create(
+	    func_type, 
+	    info.exported ? llvm::Function::ExternalLinkage : llvm::Function::InternalLinkage,
+	    info.name,
+	    _module
+    );
+
+    auto param = info.params.begin();
+    for(llvm::Argument& arg: func->args()) {
+	arg.setName(*param++);
+    }
+
+    // nothing outside of the module calls internal functions, they can use the faster convention
+    if(!info.exported) {
+	func->setCallingConv(llvm::CallingConv::Fast);
+    }
+
+    if(info.attributes.pure) {
+	func->setDoesNotAccessMemory();
+    }
+    if(info.attributes.nounwind) {
+	func->setDoesNotThrow();
+    }
+    if(info.attributes.norecurse) {
+	func->setDoesNotRecurse();
+    }
+    if(info.attributes.willreturn) {
+	func->setWillReturn();
+    }
+
+    // the linker groups .text.hot and .text.unlikely, keeping rarely run code
+    // out of the cache lines and pages of the hot functions
+    if(info.hot.has_value()) {
+	func->addFnAttr(*info.hot ? llvm::Attribute::Hot : llvm::Attribute::Cold);
+	func->setSectionPrefix(*info.hot ? "hot" : "unlikely");
+    }
+
+    _prototypes.push_back(func);
+    return func;
+}
+
 auto code_generator::return_statement(const visitor& visitor, const return_statement_node& node) -> llvm::Value* {
     std::cout << "return statement" << std::endl;
+    location_pusher location{this, node.payload()};
+    if(const auto* callee = std::any_cast<call_node>(&node.child_at(0)); callee != nullptr && callee->payload().builtin == nullptr) {
+	return tail_call(visitor, std::any_cast<const call_node&>(node.child_at(0)));
+    }
     return _builder.CreateRet(any_tree::visit_node(visitor, node.child_at(0)));
 }
 
+auto code_generator::tail_call(const visitor& visitor, const call_node& node) -> llvm::Value* {
+    llvm::Function* caller = _scope.function();
+    bool self_call = node.payload().callee_index < _prototypes.size() && _prototypes[node.payload().callee_index] == caller;
+
+    if(self_call && _tail_header != nullptr) {
+	return self_tail_call(visitor, node);
+    }
+
+    auto* inst = llvm::dyn_cast_or_null<llvm::CallInst>(call(visitor, node));
+    if(inst == nullptr) {
+	return nullptr;
+    }
+
+    // only musttail guarantees the frame is reused, it needs identical
+    // prototypes and conventions. tail is a hint the backend may drop, so
+    // such a call can still grow the stack and is reported
+    llvm::Function* callee = inst->getCalledFunction();
+    bool must = callee->getFunctionType() == caller->getFunctionType() && callee->getCallingConv() == caller->getCallingConv();
+    inst->setTailCallKind(must ? llvm::CallInst::TCK_MustTail : llvm::CallInst::TCK_Tail);
+    if(!must) {
+	std::cout << "tail call to " << callee->getName().str() << " is not guaranteed, prototypes differ" << std::endl;
+    }
+
+    if(inst->getType()->isVoidTy()) {
+	return _builder.CreateRetVoid();
+    }
+    return _builder.CreateRet(inst);
+}
+
+auto code_generator::self_tail_call(const visitor& visitor, const call_node& node) -> llvm::Value* {
+    // every argument is evaluated before any parameter is overwritten
+    std::vector<llvm::Value*> arguments{};
+    arguments.reserve(node.children_size());
+
+    std::ranges::transform(
+	    node.children(), 
+	    std::back_inserter(arguments),
+	    [&visitor] (const std::any& node) { return any_tree::visit_node(visitor, node); }
+    );
+
+    bool invalid_arguments = std::ranges::any_of(
+	    arguments, 
+	    [] (llvm::Value* value) { return value == nullptr; }
+    );
+    if(invalid_arguments || arguments.size() != _params.size()) {
+	std::cout << "invalid call argument" << std::endl;
+	return nullptr;
+    }
+
+    for(std::size_t i = 0; i < arguments.size(); ++i) {
+	write_variable(_params[i], arguments[i]);
+    }
+
+    return _builder.CreateBr(_tail_header);
+}
+
+void code_generator::branch_to(llvm::BasicBlock* target) {
+    // a block that already returned does not fall through
+    if(_builder.GetInsertBlock()->getTerminator() == nullptr) {
+	_builder.CreateBr(target);
+    }
+}
+
 auto code_generator::let_statement(const visitor& visitor, const let_statement_node& node) -> llvm::Value* {
     std::cout << "let statement" << std::endl;
 
@@ -117,14 +273,18 @@ auto code_generator::let_statement(const visitor& visitor, const let_statement_n
 
 auto code_generator::var_def(const visitor& visitor, const var_def_node& node) -> llvm::Value* {
     std::cout << "variable definition" << std::endl;
+    location_pusher location{this, node.payload().position};
 
     llvm::Type* type = *_types->get(node.payload().type).value_or(type::type{});
 
-    llvm::AllocaInst* inst = entry_builder(_scope.function()).CreateAlloca(type, nullptr, node.payload().name);
+    ssa_builder::variable* var = make_variable(node.payload().name, type);
 
     if(node.children().empty()) {
-	_scope.add(node.payload().name, inst);
-	return inst;
+	_scope.add(node.payload().name, var);
+	if(var->slot != nullptr) {
+	    return var->slot;
+	}
+	return llvm::UndefValue::get(type);
     }
 
     llvm::Value* value = any_tree::visit_node(visitor, node.child_at(0));
@@ -133,14 +293,25 @@ auto code_generator::var_def(const visitor& visitor, const var_def_node& node) -
 	return nullptr;
     }
 
-    _builder.CreateStore(value, inst);
+    write_variable(var, value);
 
-    _scope.add(node.payload().name, inst);
-    return inst;
+    _scope.add(node.payload().name, var);
+    if(var->slot != nullptr) {
+	return var->slot;
+    }
+    return value;
 }
 
 auto code_generator::binary_expr(const visitor& visitor, const binary_expr_node& node) -> llvm::Value* {
     std::cout << "binary" << std::endl;
+    location_pusher location{this, node.payload().position};
+    if(node.payload().oper == "=" && node.child_at(0).type() == typeid(identifier_node)) {
+	return assign(visitor, node);
+    }
+    if(node.payload().oper == "=" && (node.child_at(0).type() == typeid(index_node) || node.child_at(0).type() == typeid(field_node))) {
+	return assign_in_place(visitor, node);
+    }
+
     llvm::Value* lhs = any_tree::visit_node(visitor, node.child_at(0));
     if(lhs == nullptr) {
 	std::cout << "invalid lhs expression" << std::endl;
@@ -178,6 +349,7 @@ auto code_generator::binary_expr(const visitor& visitor, const binary_expr_node&
 
 auto code_generator::if_stmt(const visitor& visitor, const if_node& node) -> llvm::Value* {
     std::cout << "if_stmt" << std::endl;
+    location_pusher location{this, node.payload().position};
     if(node.payload().has_let && any_tree::visit_node(visitor, node.child_at(0)) == nullptr) {
 	return nullptr;
     }
@@ -190,7 +362,7 @@ auto code_generator::if_stmt(const visitor& visitor, const if_node& node) -> llv
     llvm::BasicBlock* then_block = llvm::BasicBlock::Create(*_context, "then", _scope.function());
     llvm::BasicBlock* merge_block = llvm::BasicBlock::Create(*_context, "if_merge", _scope.function());
 
-    _builder.CreateCondBr(cond, then_block, merge_block);
+    _builder.CreateCondBr(cond, then_block, merge_block, branch_weights(node.payload().likely));
 
     // then
     _builder.SetInsertPoint(then_block);
@@ -200,7 +372,7 @@ auto code_generator::if_stmt(const visitor& visitor, const if_node& node) -> llv
 	return nullptr;
     }
 
-    _builder.CreateBr(merge_block);
+    branch_to(merge_block);
 
     // merge
     _builder.SetInsertPoint(merge_block);
@@ -210,6 +382,7 @@ auto code_generator::if_stmt(const visitor& visitor, const if_node& node) -> llv
 
 auto code_generator::if_else_stmt(const visitor& visitor, const if_else_node& node) -> llvm::Value* {
     std::cout << "if_else_stmt" << std::endl;
+    location_pusher location{this, node.payload().position};
     if(node.payload().has_let && any_tree::visit_node(visitor, node.child_at(0)) == nullptr) {
 	return nullptr;
     }
@@ -223,7 +396,7 @@ auto code_generator::if_else_stmt(const visitor& visitor, const if_else_node& no
     llvm::BasicBlock* else_block = llvm::BasicBlock::Create(*_context, "else", _scope.function());
     llvm::BasicBlock* merge_block = llvm::BasicBlock::Create(*_context, "if_merge", _scope.function());
 
-    _builder.CreateCondBr(cond, then_block, else_block);
+    _builder.CreateCondBr(cond, then_block, else_block, branch_weights(node.payload().likely));
 
     // then
     _builder.SetInsertPoint(then_block);
@@ -233,7 +406,7 @@ auto code_generator::if_else_stmt(const visitor& visitor, const if_else_node& no
 	return nullptr;
     }
 
-    _builder.CreateBr(merge_block);
+    branch_to(merge_block);
     then_block = _builder.GetInsertBlock();
 
     // else
@@ -244,7 +417,7 @@ auto code_generator::if_else_stmt(const visitor& visitor, const if_else_node& no
 	return nullptr;
     }
 
-    _builder.CreateBr(merge_block);
+    branch_to(merge_block);
 
     // merge
     _builder.SetInsertPoint(merge_block);
@@ -254,6 +427,7 @@ auto code_generator::if_else_stmt(const visitor& visitor, const if_else_node& no
 
 auto code_generator::if_else_expr(const visitor& visitor, const if_else_expr_node& node) -> llvm::Value* {
     std::cout << "if_else_expr" << std::endl;
+    location_pusher location{this, node.payload().position};
     if(node.payload().has_let && any_tree::visit_node(visitor, node.child_at(0)) == nullptr) {
 	return nullptr;
     }
@@ -263,11 +437,21 @@ auto code_generator::if_else_expr(const visitor& visitor, const if_else_expr_nod
 	return nullptr;
     }
 
+    // a branch costs a misprediction now and then, evaluating both cheap arms does not.
+    // one the source says is biased is rarely mispredicted, so it stays a branch
+    if(_options.selects == select_mode::always || (_options.selects == select_mode::cheap && !node.payload().likely.has_value())) {
+	std::optional<std::size_t> then_cost = arm_cost(node.child_at(2));
+	std::optional<std::size_t> else_cost = arm_cost(node.child_at(3));
+	if(then_cost.has_value() && else_cost.has_value() && (_options.selects == select_mode::always || *then_cost + *else_cost <= _options.select_cost)) {
+	    return select(visitor, node, cond);
+	}
+    }
+
     llvm::BasicBlock* then_block = llvm::BasicBlock::Create(*_context, "then", _scope.function());
     llvm::BasicBlock* else_block = llvm::BasicBlock::Create(*_context, "else", _scope.function());
     llvm::BasicBlock* merge_block = llvm::BasicBlock::Create(*_context, "if_merge", _scope.function());
 
-    _builder.CreateCondBr(cond, then_block, else_block);
+    _builder.CreateCondBr(cond, then_block, else_block, branch_weights(node.payload().likely));
 
     // then
     _builder.SetInsertPoint(then_block);
@@ -301,50 +485,221 @@ auto code_generator::if_else_expr(const visitor& visitor, const if_else_expr_nod
     return phi;
 }
 
+auto code_generator::select(const visitor& visitor, const if_else_expr_node& node, llvm::Value* cond) -> llvm::Value* {
+    llvm::Value* then_value = any_tree::visit_node(visitor, node.child_at(2));
+    if(then_value == nullptr) {
+	return nullptr;
+    }
+
+    llvm::Value* else_value = any_tree::visit_node(visitor, node.child_at(3));
+    if(else_value == nullptr) {
+	return nullptr;
+    }
+
+    return _builder.CreateSelect(cond, then_value, else_value, "select");
+}
+
+auto code_generator::arm_cost(const std::any& block) const -> std::optional<std::size_t> {
+    const auto* arm = std::any_cast<block_node>(&block);
+    if(arm == nullptr || arm->children_size() != 1) {
+	return {};
+    }
+    return speculation_cost(arm->child_at(0));
+}
+
+// empty when node may trap, has side effects or emits blocks of its own
+auto code_generator::speculation_cost(const std::any& node) const -> std::optional<std::size_t> {
+    auto children_cost = [this] (const auto& node) -> std::optional<std::size_t> {
+	std::size_t total = 1;
+	for(std::size_t i = 0; i < node.children_size(); ++i) {
+	    std::optional<std::size_t> cost = speculation_cost(node.child_at(i));
+	    if(!cost.has_value()) {
+		return {};
+	    }
+	    total += *cost;
+	}
+	return total;
+    };
+
+    const std::type_info& type = node.type();
+    if(type == typeid(identifier_node) || type == typeid(integer_literal_node) || type == typeid(floating_literal_node)
+	    || type == typeid(char_literal_node) || type == typeid(bool_literal_node) || type == typeid(string_literal_node)) {
+	return 0;
+    }
+
+    if(const auto* binary = std::any_cast<binary_expr_node>(&node); binary != nullptr) {
+	const binary_expr_info& info = binary->payload();
+	llvm::Type* operand_t = *_types->get(info.lhs).value_or(type::type{});
+	bool integer = operand_t != nullptr && operand_t->isIntOrIntVectorTy();
+
+	if(info.oper == "=" || (integer && _options.checked_arithmetic && (info.oper == "+" || info.oper == "-" || info.oper == "*"))) {
+	    return {};
+	}
+
+	// integer division by zero or INT_MIN / -1 is undefined, so only known divisors are safe
+	if(integer && info.oper == "/") {
+	    const auto* divisor = std::any_cast<integer_literal_node>(&binary->child_at(1));
+	    if(divisor == nullptr) {
+		return {};
+	    }
+	    llvm::APInt value{operand_t->getScalarSizeInBits(), divisor->payload().value};
+	    if(value.isZero() || value.isAllOnes()) {
+		return {};
+	    }
+	}
+	return children_cost(*binary);
+    }
+
+    if(const auto* cast = std::any_cast<implicit_cast_node>(&node); cast != nullptr) {
+	return children_cost(*cast);
+    }
+    if(const auto* call = std::any_cast<call_node>(&node); call != nullptr && call->payload().builtin != nullptr) {
+	return children_cost(*call);
+    }
+    if(const auto* field = std::any_cast<field_node>(&node); field != nullptr) {
+	return children_cost(*field);
+    }
+    return {};
+}
+
 auto code_generator::loop_stmt(const visitor& visitor, const loop_node& node) -> llvm::Value* {
     std::cout << "loop" << std::endl;
+    location_pusher location{this, node.payload().position};
     if(const auto& let = node.child_at(0); let.has_value() && any_tree::visit_node(visitor, let) == nullptr) {
 	return nullptr;
     }
 
-    llvm::BasicBlock* loop = llvm::BasicBlock::Create(*_context, "loop", _scope.function());
-    llvm::BasicBlock* after = llvm::BasicBlock::Create(*_context, "loop_after", _scope.function());
+    // preheader -> header (condition) -> body -> latch (post) -> header, the
+    // condition is emitted once, LoopRotate turns it into a bottom tested loop
+    llvm::BasicBlock* preheader = llvm::BasicBlock::Create(*_context, "loop_preheader", _scope.function());
+    llvm::BasicBlock* header = llvm::BasicBlock::Create(*_context, "loop_header", _scope.function());
+    llvm::BasicBlock* body = llvm::BasicBlock::Create(*_context, "loop_body", _scope.function());
+    llvm::BasicBlock* latch = llvm::BasicBlock::Create(*_context, "loop_latch", _scope.function());
+    llvm::BasicBlock* exit = llvm::BasicBlock::Create(*_context, "loop_exit", _scope.function());
 
-    const auto& condition = node.child_at(1);
+    _builder.CreateBr(preheader);
+    _builder.SetInsertPoint(preheader);
+    _builder.CreateBr(header);
 
+    // the back edge is not there yet
+    _ssa.unseal(header);
+    _builder.SetInsertPoint(header);
+
+    const auto& condition = node.child_at(1);
     if(condition.has_value()) {
 	llvm::Value* cond = any_tree::visit_node(visitor, condition);
 	if(cond == nullptr) {
 	    return nullptr;
 	}
-	_builder.CreateCondBr(cond, loop, after);
+	_builder.CreateCondBr(cond, body, exit, loop_weights(node.payload()));
     } else {
-	_builder.CreateBr(loop);
+	_builder.CreateBr(body);
     }
 
-    _builder.SetInsertPoint(loop);
+    _builder.SetInsertPoint(body);
 
     llvm::Value* loop_value = any_tree::visit_node(visitor, node.child_at(3));
     if(loop_value == nullptr) {
 	return nullptr;
     }
 
+    branch_to(latch);
+    _builder.SetInsertPoint(latch);
+
     if(const auto& post = node.child_at(2); post.has_value() && any_tree::visit_node(visitor, post) == nullptr) {
 	return nullptr;
     }
 
-    if(condition.has_value()) {
-	llvm::Value* cond = any_tree::visit_node(visitor, condition);
-	_builder.CreateCondBr(cond, loop, after);
-    } else {
-	_builder.CreateBr(loop);
-    }
+    llvm::BranchInst* back_edge = _builder.CreateBr(header);
+    back_edge->setMetadata(llvm::LLVMContext::MD_loop, loop_metadata(node.payload(), condition.has_value()));
+    _ssa.seal(header);
 
-    _builder.SetInsertPoint(after);
+    _builder.SetInsertPoint(exit);
 
     return loop_value;
 }
 
+// same bias as __builtin_expect in clang
+auto code_generator::branch_weights(std::optional<bool> likely) -> llvm::MDNode* {
+    if(!likely.has_value()) {
+	return nullptr;
+    }
+
+    constexpr std::uint32_t hot = 2000;
+    constexpr std::uint32_t cold = 1;
+    llvm::MDBuilder builder{*_context};
+    return *likely ? builder.createBranchWeights(hot, cold) : builder.createBranchWeights(cold, hot);
+}
+
+// the header is left once for every expected_trip_count times the body is entered
+auto code_generator::loop_weights(const loop_info& info) -> llvm::MDNode* {
+    if(info.expected_trip_count != 0) {
+	return llvm::MDBuilder{*_context}.createBranchWeights(info.expected_trip_count, 1);
+    }
+    return branch_weights(info.likely);
+}
+
+auto code_generator::subprogram(const function_info& info, llvm::Function* func) -> llvm::DISubprogram* {
+    // line tables need no parameter or return types
+    llvm::DISubroutineType* type = _debug->createSubroutineType(_debug->getOrCreateTypeArray({}));
+
+    llvm::DISubprogram::DISPFlags flags = llvm::DISubprogram::SPFlagDefinition;
+    if(func->hasLocalLinkage()) {
+	flags |= llvm::DISubprogram::SPFlagLocalToUnit;
+    }
+
+    llvm::DISubprogram* program = _debug->createFunction(_unit->getFile(), info.name, {}, _unit->getFile(), info.position.line, type, info.position.line, llvm::DINode::FlagPrototyped, flags);
+    func->setSubprogram(program);
+    return program;
+}
+
+code_generator::location_pusher::location_pusher(code_generator* generator, const source_position& position)
+    : _builder{&generator->_builder}
+    , _saved{generator->_builder.getCurrentDebugLocation()}
+{
+    // nodes without a position take the enclosing node's, a function without
+    // one gets line 0 so that every instruction in it has a location
+    if(generator->_subprogram != nullptr && (position.line != 0 || !_saved)) {
+	_builder->SetCurrentDebugLocation(llvm::DILocation::get(*generator->_context, position.line, position.column, generator->_subprogram));
+    }
+}
+
+auto code_generator::loop_metadata(const loop_info& info, bool has_condition) -> llvm::MDNode* {
+    auto flag = [this] (const char* name) {
+	return llvm::MDNode::get(*_context, llvm::MDString::get(*_context, name));
+    };
+    auto value = [this] (const char* name, llvm::Constant* constant) {
+	return llvm::MDNode::get(*_context, {llvm::MDString::get(*_context, name), llvm::ConstantAsMetadata::get(constant)});
+    };
+
+    // first operand is the loop id itself
+    std::vector<llvm::Metadata*> properties{nullptr};
+
+    // a loop without a condition is meant to run forever, everything else may
+    // be assumed to terminate or have side effects
+    if(has_condition) {
+	properties.push_back(flag("llvm.loop.mustprogress"));
+    }
+
+    if(info.unroll.has_value()) {
+	properties.push_back(flag(*info.unroll ? "llvm.loop.unroll.enable" : "llvm.loop.unroll.disable"));
+    }
+    if(info.unroll_count != 0) {
+	properties.push_back(value("llvm.loop.unroll.count", _builder.getInt32(info.unroll_count)));
+    }
+
+    if(info.vectorize.has_value()) {
+	properties.push_back(value("llvm.loop.vectorize.enable", _builder.getInt1(*info.vectorize)));
+    }
+    if(info.vectorize_width != 0) {
+	properties.push_back(value("llvm.loop.vectorize.width", _builder.getInt32(info.vectorize_width)));
+    }
+
+    llvm::MDNode* loop_id = llvm::MDNode::getDistinct(*_context, properties);
+    loop_id->replaceOperandWith(0, loop_id);
+    return loop_id;
+}
+
 auto code_generator::block(const visitor& visitor, const block_node& node) -> llvm::Value* {
     std::vector<llvm::Value*> statements{};
     statements.reserve(node.children_size());
@@ -369,10 +724,14 @@ auto code_generator::block(const visitor& visitor, const block_node& node) -> ll
 
 auto code_generator::call(const visitor& visitor, const call_node& node) -> llvm::Value* {
     std::cout << "call" << std::endl;
-    llvm::Function* callee = _module.getFunction(node.payload().callee);
-    if(callee == nullptr) {
+    location_pusher location{this, node.payload().position};
+    if(node.payload().builtin != nullptr) {
+	return builtin_call(visitor, node);
+    }
+    if(node.payload().callee_index >= _prototypes.size()) {
 	return nullptr;
     }
+    llvm::Function* callee = _prototypes[node.payload().callee_index];
 
     std::vector<llvm::Value*> param_values{};
     param_values.reserve(callee->arg_size());
@@ -392,7 +751,31 @@ auto code_generator::call(const visitor& visitor, const call_node& node) -> llvm
 	return nullptr;
     }
 
-    return _builder.CreateCall(callee, param_values, "call");
+    llvm::CallInst* inst = _builder.CreateCall(callee, param_values, callee->getReturnType()->isVoidTy() ? "" : "call");
+    inst->setCallingConv(callee->getCallingConv());
+    return inst;
+}
+
+auto code_generator::builtin_call(const visitor& visitor, const call_node& node) -> llvm::Value* {
+    std::vector<llvm::Value*> arguments{};
+    arguments.reserve(node.children_size());
+
+    std::ranges::transform(
+	    node.children(), 
+	    std::back_inserter(arguments),
+	    [&visitor] (const std::any& node) { return any_tree::visit_node(visitor, node); }
+    );
+
+    if(std::ranges::any_of(arguments, [] (llvm::Value* value) { return value == nullptr; })) {
+	std::cout << "invalid call argument" << std::endl;
+	return nullptr;
+    }
+
+    llvm::Value* result = node.payload().builtin->inserter(&_builder, arguments);
+    if(result == nullptr) {
+	std::cout << "invalid arguments to builtin " << node.payload().callee << std::endl;
+    }
+    return result;
 }
 
 auto code_generator::implicit_cast(const visitor& visitor, const implicit_cast_node& node) -> llvm::Value* {
@@ -410,21 +793,290 @@ auto code_generator::implicit_cast(const visitor& visitor, const implicit_cast_n
     return cast.value()(&_builder, inner);
 }
 
+auto code_generator::array_literal(const visitor& visitor, const array_literal_node& node) -> llvm::Value* {
+    std::cout << "array_literal" << std::endl;
+    auto* array_t = llvm::dyn_cast_or_null<llvm::ArrayType>(*_types->get(node.payload().type).value_or(type::type{}));
+    if(array_t == nullptr) {
+	return nullptr;
+    }
+
+    std::vector<llvm::Value*> elements{};
+    elements.reserve(node.children_size());
+
+    std::ranges::transform(
+	    node.children(),
+	    std::back_inserter(elements),
+	    [&visitor] (const std::any& node) { return any_tree::visit_node(visitor, node); }
+    );
+
+    if(std::ranges::any_of(elements, [] (llvm::Value* value) { return value == nullptr; })) {
+	std::cout << "invalid array element" << std::endl;
+	return nullptr;
+    }
+
+    // constant arrays are a single value, the rest is built up element by element
+    if(std::ranges::all_of(elements, [] (llvm::Value* value) { return llvm::isa<llvm::Constant>(value); })) {
+	std::vector<llvm::Constant*> constants{};
+	constants.reserve(elements.size());
+	std::ranges::transform(elements, std::back_inserter(constants), [] (llvm::Value* value) { return llvm::cast<llvm::Constant>(value); });
+	return llvm::ConstantArray::get(array_t, constants);
+    }
+
+    llvm::Value* array = llvm::PoisonValue::get(array_t);
+    for(unsigned i = 0; i < elements.size(); ++i) {
+	array = _builder.CreateInsertValue(array, elements[i], {i});
+    }
+    return array;
+}
+
+auto code_generator::index(const visitor& visitor, const index_node& node) -> llvm::Value* {
+    std::cout << "index" << std::endl;
+    llvm::Value* address = element_address(visitor, node);
+    if(address == nullptr) {
+	return nullptr;
+    }
+
+    llvm::Type* element_t = *_types->get(node.payload().element).value_or(type::type{});
+    return _builder.CreateAlignedLoad(element_t, address, _module.getDataLayout().getABITypeAlign(element_t), "elem");
+}
+
+auto code_generator::struct_literal(const visitor& visitor, const struct_literal_node& node) -> llvm::Value* {
+    std::cout << "struct_literal" << std::endl;
+    auto* struct_t = llvm::dyn_cast_or_null<llvm::StructType>(*_types->get(node.payload().type).value_or(type::type{}));
+    if(struct_t == nullptr) {
+	return nullptr;
+    }
+
+    // children follow the source, members the layout
+    std::vector<llvm::Value*> members(struct_t->getNumElements());
+    for(std::size_t i = 0; i < node.children_size(); ++i) {
+	llvm::Value* value = any_tree::visit_node(visitor, node.children()[i]);
+	if(value == nullptr) {
+	    std::cout << "invalid field value" << std::endl;
+	    return nullptr;
+	}
+	members[node.payload().members[i]] = value;
+    }
+
+    if(std::ranges::all_of(members, [] (llvm::Value* value) { return llvm::isa<llvm::Constant>(value); })) {
+	std::vector<llvm::Constant*> constants{};
+	constants.reserve(members.size());
+	std::ranges::transform(members, std::back_inserter(constants), [] (llvm::Value* value) { return llvm::cast<llvm::Constant>(value); });
+	return llvm::ConstantStruct::get(struct_t, constants);
+    }
+
+    llvm::Value* result = llvm::PoisonValue::get(struct_t);
+    for(unsigned i = 0; i < members.size(); ++i) {
+	result = _builder.CreateInsertValue(result, members[i], {i});
+    }
+    return result;
+}
+
+auto code_generator::field(const visitor& visitor, const field_node& node) -> llvm::Value* {
+    std::cout << "field" << std::endl;
+    // values that are not in memory, like call results, are taken apart directly
+    if(!in_memory(node.child_at(0))) {
+	llvm::Value* value = any_tree::visit_node(visitor, node.child_at(0));
+	if(value == nullptr) {
+	    return nullptr;
+	}
+	return _builder.CreateExtractValue(value, {static_cast<unsigned>(node.payload().index)}, node.payload().name);
+    }
+
+    llvm::Value* address = field_address(visitor, node);
+    if(address == nullptr) {
+	return nullptr;
+    }
+
+    llvm::Type* member_t = *_types->get(node.payload().member).value_or(type::type{});
+    return _builder.CreateAlignedLoad(member_t, address, _module.getDataLayout().getABITypeAlign(member_t), node.payload().name);
+}
+
+auto code_generator::element_address(const visitor& visitor, const index_node& node) -> llvm::Value* {
+    llvm::Type* array_t = *_types->get(node.payload().array).value_or(type::type{});
+    if(array_t == nullptr) {
+	return nullptr;
+    }
+
+    llvm::Value* base = address_of(visitor, node.child_at(0), array_t);
+    if(base == nullptr) {
+	return nullptr;
+    }
+
+    llvm::Value* index = any_tree::visit_node(visitor, node.child_at(1));
+    if(index == nullptr) {
+	std::cout << "invalid index expression" << std::endl;
+	return nullptr;
+    }
+
+    // negative signed indexes become huge after sign extension and fail the unsigned check
+    index = _builder.CreateIntCast(index, _builder.getInt64Ty(), node.payload().signed_index, "idx");
+    if(_options.bounds_checks) {
+	bounds_check(index, node.payload().length);
+    }
+
+    return _builder.CreateInBoundsGEP(array_t, base, {_builder.getInt64(0), index}, "elem.addr");
+}
+
+auto code_generator::field_address(const visitor& visitor, const field_node& node) -> llvm::Value* {
+    llvm::Type* struct_t = *_types->get(node.payload().type).value_or(type::type{});
+    if(struct_t == nullptr) {
+	return nullptr;
+    }
+
+    llvm::Value* base = address_of(visitor, node.child_at(0), struct_t);
+    if(base == nullptr) {
+	return nullptr;
+    }
+
+    return _builder.CreateStructGEP(struct_t, base, static_cast<unsigned>(node.payload().index), node.payload().name + ".addr");
+}
+
+auto code_generator::address_of(const visitor& visitor, const std::any& node, llvm::Type* type) -> llvm::Value* {
+    // variables, their elements and fields are addressed in place, nothing is copied
+    if(const auto* name = std::any_cast<identifier_node>(&node); name != nullptr) {
+	ssa_builder::variable* var = _scope.get(name->payload()).value_or(nullptr);
+	if(var != nullptr && var->slot != nullptr) {
+	    return var->slot;
+	}
+    }
+    if(const auto* element = std::any_cast<index_node>(&node); element != nullptr) {
+	return element_address(visitor, *element);
+    }
+    if(const auto* member = std::any_cast<field_node>(&node); member != nullptr) {
+	return field_address(visitor, *member);
+    }
+
+    // temporaries like call results get a slot of their own
+    llvm::Value* value = any_tree::visit_node(visitor, node);
+    if(value == nullptr) {
+	return nullptr;
+    }
+
+    llvm::AllocaInst* slot = entry_builder(_scope.function()).CreateAlloca(type, nullptr, "tmp");
+    _builder.CreateAlignedStore(value, slot, slot->getAlign());
+    return slot;
+}
+
+auto code_generator::in_memory(const std::any& node) -> bool {
+    if(const auto* name = std::any_cast<identifier_node>(&node); name != nullptr) {
+	ssa_builder::variable* var = _scope.get(name->payload()).value_or(nullptr);
+	return var != nullptr && var->slot != nullptr;
+    }
+    if(const auto* member = std::any_cast<field_node>(&node); member != nullptr) {
+	return in_memory(member->child_at(0));
+    }
+    return node.type() == typeid(index_node);
+}
+
+void code_generator::bounds_check(llvm::Value* index, std::uint64_t length) {
+    // constant indexes in range are the only checks dropped here. a check
+    // dominated by a loop condition is left to ConstraintElimination, which
+    // only runs from -O2 on, at the default -O1 it stays in the loop
+    if(auto* constant = llvm::dyn_cast<llvm::ConstantInt>(index); constant != nullptr && constant->getZExtValue() < length) {
+	return;
+    }
+
+    llvm::Function* func = _builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* in_bounds = llvm::BasicBlock::Create(*_context, "inbounds", func);
+    llvm::BasicBlock* out_of_bounds = llvm::BasicBlock::Create(*_context, "outofbounds", func);
+
+    llvm::Value* check = _builder.CreateICmpULT(index, _builder.getInt64(length), "inbounds");
+    _builder.CreateCondBr(check, in_bounds, out_of_bounds, llvm::MDBuilder{*_context}.createBranchWeights((1U << 20) - 1, 1));
+
+    _builder.SetInsertPoint(out_of_bounds);
+    _builder.CreateIntrinsic(llvm::Intrinsic::trap, {}, {});
+    _builder.CreateUnreachable();
+
+    _builder.SetInsertPoint(in_bounds);
+}
+
 auto code_generator::identifier(const identifier_node& node) -> llvm::Value* {
     std::cout << "identifier" << std::endl;
 
-    llvm::AllocaInst* inst = _scope.get(node.payload()).value_or(nullptr);
+    ssa_builder::variable* var = _scope.get(node.payload()).value_or(nullptr);
 
-    if(inst == nullptr) {
+    if(var == nullptr) {
+	return nullptr;
+    }
+
+    return read_variable(var);
+}
+
+auto code_generator::assign(const visitor& visitor, const binary_expr_node& node) -> llvm::Value* {
+    ssa_builder::variable* var = _scope.get(std::any_cast<const identifier_node&>(node.child_at(0)).payload()).value_or(nullptr);
+    if(var == nullptr) {
+	std::cout << "invalid lhs expression" << std::endl;
+	return nullptr;
+    }
+
+    llvm::Value* rhs = any_tree::visit_node(visitor, node.child_at(1));
+    if(rhs == nullptr) {
+	std::cout << "invalid rhs expression" << std::endl;
+	return nullptr;
+    }
+
+    if(var->slot != nullptr) {
+	return _builder.CreateStore(rhs, var->slot);
+    }
+
+    write_variable(var, rhs);
+    return rhs;
+}
+
+auto code_generator::assign_in_place(const visitor& visitor, const binary_expr_node& node) -> llvm::Value* {
+    llvm::Value* address = address_of(visitor, node.child_at(0), nullptr);
+    if(address == nullptr) {
+	std::cout << "invalid lhs expression" << std::endl;
 	return nullptr;
     }
 
-    return _builder.CreateLoad(inst->getAllocatedType(), inst, node.payload());
+    llvm::Value* rhs = any_tree::visit_node(visitor, node.child_at(1));
+    if(rhs == nullptr) {
+	std::cout << "invalid rhs expression" << std::endl;
+	return nullptr;
+    }
+
+    _builder.CreateAlignedStore(rhs, address, _module.getDataLayout().getABITypeAlign(rhs->getType()));
+    return rhs;
+}
+
+auto code_generator::make_variable(const std::string& name, llvm::Type* type) -> ssa_builder::variable* {
+    // aggregates are accessed through their address, they stay in memory
+    if(!_options.ssa || !type->isSingleValueType()) {
+	llvm::AllocaInst* slot = entry_builder(_scope.function()).CreateAlloca(type, nullptr, name);
+	// arrays of 16 bytes and more start on a vector boundary, like the x86-64 ABI asks for
+	if(type->isArrayTy() && _module.getDataLayout().getTypeAllocSize(type) >= 16) {
+	    slot->setAlignment(std::max(slot->getAlign(), llvm::Align{16}));
+	}
+	return _ssa.make_variable(name, type, slot);
+    }
+    return _ssa.make_variable(name, type);
+}
+
+auto code_generator::read_variable(const ssa_builder::variable* var) -> llvm::Value* {
+    if(var->slot != nullptr) {
+	return _builder.CreateLoad(var->type, var->slot, var->name);
+    }
+    return _ssa.read(var, _builder.GetInsertBlock());
+}
+
+void code_generator::write_variable(const ssa_builder::variable* var, llvm::Value* value) {
+    if(var->slot != nullptr) {
+	_builder.CreateStore(value, var->slot);
+	return;
+    }
+    _ssa.write(var, _builder.GetInsertBlock(), value);
 }
 
 auto code_generator::integer_literal(const integer_literal_node& node) -> llvm::Value* {
     std::cout << "integer_literal" << std::endl;
-    return llvm::ConstantInt::get(*_types->get(node.payload().type).value_or(type::type{}), node.payload().value);
+    llvm::Type* type = *_types->get(node.payload().type).value_or(type::type{});
+    // integer literals may be typed as floats, "x + 1" with a float x
+    if(type->isFPOrFPVectorTy()) {
+	return llvm::ConstantFP::get(type, static_cast<double>(node.payload().value));
+    }
+    return llvm::ConstantInt::get(type, node.payload().value);
 }
 
 auto code_generator::floating_literal(const floating_literal_node& node) -> llvm::Value* {
@@ -438,8 +1090,30 @@ auto code_generator::char_literal(const char_literal_node& node) -> llvm::Value*
 }
 
 auto code_generator::string_literal(const string_literal_node& node) -> llvm::Value* {
-    // not implemented yet
-    return nullptr;
+    std::cout << "string_literal" << std::endl;
+    const std::string& value = node.payload().value;
+    llvm::GlobalVariable* storage = string_constant(value);
+
+    // the slice points into the constant, nothing is copied. pointers are
+    // opaque, the global's address is already the address of its first byte
+    auto* str_t = llvm::cast<llvm::StructType>(*_types->get(node.payload().type).value_or(type::type{}));
+    return llvm::ConstantStruct::get(str_t, storage, _builder.getInt64(value.size()));
+}
+
+auto code_generator::string_constant(const std::string& value) -> llvm::GlobalVariable* {
+    auto [iter, inserted] = _strings.try_emplace(value);
+    if(!inserted) {
+	return iter->second;
+    }
+
+    // private, unnamed_addr and null terminated puts it in a mergeable
+    // .rodata.str1.1 section, so the linker also folds copies across objects.
+    // the terminator is not part of the length
+    llvm::Constant* bytes = llvm::ConstantDataArray::getString(*_context, value, true);
+    auto* storage = new llvm::GlobalVariable{_module, bytes->getType(), true, llvm::GlobalValue::PrivateLinkage, bytes, ".str"};
+    storage->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    storage->setAlignment(llvm::Align{1});
+    return iter->second = storage;
 }
 
 auto code_generator::bool_literal(const bool_literal_node& node) -> llvm::Value* {
@@ -447,13 +1121,24 @@ auto code_generator::bool_literal(const bool_literal_node& node) -> llvm::Value*
     return llvm::ConstantInt::get(*_types->get(node.payload().type).value_or(type::type{}), static_cast<uint64_t>(node.payload().value));
 }
 
-code_generator::code_generator(const std::string& module_name, llvm::LLVMContext* context, special_functions* special, type::registry* types) 
+code_generator::code_generator(const std::string& module_name, llvm::LLVMContext* context, special_functions* special, type::registry* types, codegen_options options) 
     : _context{context}
     , _builder{*context}
     , _module{module_name, *context}
     , _special{special}
     , _types{types}
+    , _options{options}
 {
+    if(_options.line_tables) {
+	_module.addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+	_module.addModuleFlag(llvm::Module::Warning, "Dwarf Version", 5);
+
+	// there is no DWARF language code for the source, C is what tools handle best
+	_debug = std::make_unique<llvm::DIBuilder>(_module);
+	llvm::DIFile* file = _debug->createFile(llvm::sys::path::filename(module_name), llvm::sys::path::parent_path(module_name));
+	_unit = _debug->createCompileUnit(llvm::dwarf::DW_LANG_C, file, "compiler", true, "", 0, "", llvm::DICompileUnit::LineTablesOnly);
+    }
+
     _visitor = {
 	any_tree::make_const_child_visitor<file_node>            ([this] (const file_node& node)              { return file(_visitor, node); }),
 	any_tree::make_const_child_visitor<function_node>        ([this] (const function_node& node)          { return function(_visitor, node); }),
@@ -468,6 +1153,10 @@ code_generator::code_generator(const std::string& module_name, llvm::LLVMContext
 	any_tree::make_const_child_visitor<block_node>           ([this] (const block_node& node)             { return block(_visitor, node); }),
 	any_tree::make_const_child_visitor<call_node>            ([this] (const call_node& node)              { return call(_visitor, node); }),
 	any_tree::make_const_child_visitor<implicit_cast_node>   ([this] (const implicit_cast_node& node)     { return implicit_cast(_visitor, node); }),
+	any_tree::make_const_child_visitor<array_literal_node>   ([this] (const array_literal_node& node)     { return array_literal(_visitor, node); }),
+	any_tree::make_const_child_visitor<index_node>           ([this] (const index_node& node)             { return index(_visitor, node); }),
+	any_tree::make_const_child_visitor<struct_literal_node>  ([this] (const struct_literal_node& node)    { return struct_literal(_visitor, node); }),
+	any_tree::make_const_child_visitor<field_node>           ([this] (const field_node& node)             { return field(_visitor, node); }),
 	any_tree::make_const_child_visitor<identifier_node>      ([this] (const identifier_node& node)        { return identifier(node); }),
 	any_tree::make_const_child_visitor<integer_literal_node> ([this] (const integer_literal_node& node)   { return integer_literal(node); }),
 	any_tree::make_const_child_visitor<floating_literal_node>([this] (const floating_literal_node& node)  { return floating_literal(node); }),
@@ -477,3 +1166,9 @@ code_generator::code_generator(const std::string& module_name, llvm::LLVMContext
 	any_tree::make_const_child_visitor<void>                 ([] () { return nullptr; }),
     };
 }
+
+void code_generator::finish() {
+    if(_debug != nullptr) {
+	_debug->finalize();
+    }
+}
@@ -0,0 +1,243 @@
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <any_tree.hpp>
+
+#include "any_tree/visitor.hpp"
+#include "constant_folding.hpp"
+#include "interpreter.hpp"
+#include "scope.hpp"
+
+
+namespace {
+
+// names a function assigns to anywhere, such lets are never propagated
+auto assigned_names(const function_node& node) -> std::unordered_set<std::string> {
+    std::unordered_set<std::string> names{};
+
+    any_tree::const_children_visitor<void> visitor{};
+    auto descend = [&visitor] (const auto& node) {
+	for(std::size_t i = 0; i < node.children_size(); ++i) {
+	    if(node.child_at(i).has_value()) {
+		any_tree::visit_node(visitor, node.child_at(i));
+	    }
+	}
+    };
+    auto leaf = [] (const auto&) {};
+
+    visitor = {
+	any_tree::make_const_child_visitor<return_statement_node>(descend),
+	any_tree::make_const_child_visitor<let_statement_node>   (descend),
+	any_tree::make_const_child_visitor<var_def_node>         (descend),
+	any_tree::make_const_child_visitor<binary_expr_node>     ([&names, descend] (const binary_expr_node& node) {
+		if(const auto* name = std::any_cast<identifier_node>(&node.child_at(0)); name != nullptr && node.payload().oper == "=") {
+		    names.insert(name->payload());
+		}
+		descend(node);
+	}),
+	any_tree::make_const_child_visitor<if_node>              (descend),
+	any_tree::make_const_child_visitor<if_else_node>         (descend),
+	any_tree::make_const_child_visitor<if_else_expr_node>    (descend),
+	any_tree::make_const_child_visitor<loop_node>            (descend),
+	any_tree::make_const_child_visitor<block_node>           (descend),
+	any_tree::make_const_child_visitor<call_node>            (descend),
+	any_tree::make_const_child_visitor<implicit_cast_node>   (descend),
+	any_tree::make_const_child_visitor<array_literal_node>   (descend),
+	any_tree::make_const_child_visitor<index_node>           (descend),
+	any_tree::make_const_child_visitor<struct_literal_node>  (descend),
+	any_tree::make_const_child_visitor<field_node>           (descend),
+	any_tree::make_const_child_visitor<identifier_node>      (leaf),
+	any_tree::make_const_child_visitor<integer_literal_node> (leaf),
+	any_tree::make_const_child_visitor<floating_literal_node>(leaf),
+	any_tree::make_const_child_visitor<char_literal_node>    (leaf),
+	any_tree::make_const_child_visitor<string_literal_node>  (leaf),
+	any_tree::make_const_child_visitor<bool_literal_node>    (leaf),
+    };
+
+    any_tree::visit_node(visitor, node.child_at(0));
+    return names;
+}
+
+class constant_folder {
+    using visitor = any_tree::children_visitor<void>;
+
+    interpreter _interpreter;
+    interpreter_options _options;
+
+    // value of every local in scope, empty unless it is a literal that never changes
+    scope_manager<std::optional<constant>, const function_node*> _scope{};
+    std::unordered_set<std::string> _assigned{};
+    std::size_t _folded{};
+
+    visitor _visitor;
+
+    // folds what is below slot first, then slot itself
+    void fold(std::any& slot);
+    void descend(auto& node);
+    void replace(std::any& slot, std::optional<constant> value);
+
+    void function(function_node& node);
+    void var_def(var_def_node& node);
+    void scoped(auto& node);
+
+    auto fold_binary(const binary_expr_node& node) const -> std::optional<constant>;
+    auto fold_cast(const implicit_cast_node& node) const -> std::optional<constant>;
+    auto fold_call(const call_node& node) -> std::optional<constant>;
+
+public:
+    constant_folder(file_node& node, interpreter_options options);
+
+    auto run(file_node& node) -> std::size_t;
+};
+
+constant_folder::constant_folder(file_node& node, interpreter_options options)
+    : _interpreter{&node, options}
+    , _options{options}
+{
+    auto descend = [this] (auto& node) { this->descend(node); };
+    auto scoped = [this] (auto& node) { this->scoped(node); };
+    auto leaf = [] (auto&) {};
+
+    _visitor = {
+	any_tree::make_child_visitor<function_node>        ([this] (function_node& node) { function(node); }),
+	any_tree::make_child_visitor<var_def_node>         ([this] (var_def_node& node) { var_def(node); }),
+	any_tree::make_child_visitor<if_node>              (scoped),
+	any_tree::make_child_visitor<if_else_node>         (scoped),
+	any_tree::make_child_visitor<if_else_expr_node>    (scoped),
+	any_tree::make_child_visitor<loop_node>            (scoped),
+	any_tree::make_child_visitor<return_statement_node>(descend),
+	any_tree::make_child_visitor<let_statement_node>   (descend),
+	any_tree::make_child_visitor<binary_expr_node>     (descend),
+	any_tree::make_child_visitor<block_node>           (descend),
+	any_tree::make_child_visitor<call_node>            (descend),
+	any_tree::make_child_visitor<implicit_cast_node>   (descend),
+	any_tree::make_child_visitor<array_literal_node>   (descend),
+	any_tree::make_child_visitor<index_node>           (descend),
+	any_tree::make_child_visitor<struct_literal_node>  (descend),
+	any_tree::make_child_visitor<field_node>           (descend),
+	any_tree::make_child_visitor<identifier_node>      (leaf),
+	any_tree::make_child_visitor<integer_literal_node> (leaf),
+	any_tree::make_child_visitor<floating_literal_node>(leaf),
+	any_tree::make_child_visitor<char_literal_node>    (leaf),
+	any_tree::make_child_visitor<string_literal_node>  (leaf),
+	any_tree::make_child_visitor<bool_literal_node>    (leaf),
+    };
+}
+
+auto constant_folder::run(file_node& node) -> std::size_t {
+    for(std::any& function : node.children()) {
+	fold(function);
+    }
+    return _folded;
+}
+
+void constant_folder::fold(std::any& slot) {
+    any_tree::visit_node(_visitor, slot);
+
+    if(const auto* name = std::any_cast<identifier_node>(&slot); name != nullptr) {
+	replace(slot, _scope.get(name->payload()).value_or(std::nullopt));
+    } else if(const auto* binary = std::any_cast<binary_expr_node>(&slot); binary != nullptr) {
+	replace(slot, fold_binary(*binary));
+    } else if(const auto* cast = std::any_cast<implicit_cast_node>(&slot); cast != nullptr) {
+	replace(slot, fold_cast(*cast));
+    } else if(const auto* call = std::any_cast<call_node>(&slot); call != nullptr) {
+	replace(slot, fold_call(*call));
+    }
+}
+
+void constant_folder::descend(auto& node) {
+    for(std::size_t i = 0; i < node.children_size(); ++i) {
+	if(node.child_at(i).has_value()) {
+	    fold(node.child_at(i));
+	}
+    }
+}
+
+void constant_folder::replace(std::any& slot, std::optional<constant> value) {
+    if(!value.has_value()) {
+	return;
+    }
+    if(std::any literal = interpreter::to_literal(*value); literal.has_value()) {
+	slot = std::move(literal);
+	++_folded;
+    }
+}
+
+void constant_folder::function(function_node& node) {
+    _assigned = assigned_names(node);
+
+    // parameters shadow nothing, but keep their names from resolving to anything
+    scope_pusher pusher{&_scope, static_cast<const function_node*>(&node)};
+    for(const std::string& param : node.payload().params) {
+	_scope.add(param, std::nullopt);
+    }
+
+    descend(node);
+}
+
+void constant_folder::var_def(var_def_node& node) {
+    descend(node);
+
+    std::optional<constant> value{};
+    if(!node.children().empty() && !_assigned.contains(node.payload().name)) {
+	value = interpreter::from_literal(node.child_at(0));
+    }
+    _scope.add(node.payload().name, value);
+}
+
+void constant_folder::scoped(auto& node) {
+    scope_pusher pusher{&_scope};
+    descend(node);
+}
+
+auto constant_folder::fold_binary(const binary_expr_node& node) const -> std::optional<constant> {
+    if(node.payload().oper == "=") {
+	return {};
+    }
+
+    std::optional<constant> lhs = interpreter::from_literal(node.child_at(0));
+    std::optional<constant> rhs = interpreter::from_literal(node.child_at(1));
+    if(!lhs.has_value() || !rhs.has_value()) {
+	return {};
+    }
+    // overflow that traps or is undefined stays in the code
+    return interpreter::binary(node.payload().oper, *lhs, *rhs, node.payload().lhs, _options.arithmetic);
+}
+
+auto constant_folder::fold_cast(const implicit_cast_node& node) const -> std::optional<constant> {
+    std::optional<constant> value = interpreter::from_literal(node.child_at(0));
+    if(!value.has_value() || value->type != node.payload().from_type) {
+	return {};
+    }
+    return interpreter::cast(*value, node.payload().to_type);
+}
+
+auto constant_folder::fold_call(const call_node& node) -> std::optional<constant> {
+    if(node.payload().builtin != nullptr) {
+	return {};
+    }
+
+    std::vector<constant> arguments{};
+    arguments.reserve(node.children_size());
+    for(const std::any& child : node.children()) {
+	std::optional<constant> argument = interpreter::from_literal(child);
+	if(!argument.has_value()) {
+	    return {};
+	}
+	arguments.push_back(*argument);
+    }
+
+    std::optional<constant> result = _interpreter.run(node.payload().callee_index, arguments);
+    if(!result.has_value() || result->type != node.payload().type) {
+	return {};
+    }
+    return result;
+}
+
+} // namespace
+
+
+auto fold_constants(file_node& node, interpreter_options options) -> std::size_t {
+    return constant_folder{node, options}.run(node);
+}
@@ -1,30 +1,82 @@
 #include <iostream>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Value.h>
 
 #include "functions.hpp"
 #include "type/type_id.hpp"
 
 
-void ui_addition(special_functions& functions) {
-    auto binary = [] (llvm::IRBuilderBase* builder, llvm::Value* lhs, llvm::Value* rhs) {
-	return builder->CreateAdd(lhs, rhs, "add");
+namespace {
+
+auto overflow_intrinsic(llvm::Instruction::BinaryOps op, bool is_signed) -> llvm::Intrinsic::ID {
+    switch(op) {
+	case llvm::Instruction::Add: return is_signed ? llvm::Intrinsic::sadd_with_overflow : llvm::Intrinsic::uadd_with_overflow;
+	case llvm::Instruction::Sub: return is_signed ? llvm::Intrinsic::ssub_with_overflow : llvm::Intrinsic::usub_with_overflow;
+	default:                     return is_signed ? llvm::Intrinsic::smul_with_overflow : llvm::Intrinsic::umul_with_overflow;
+    }
+}
+
+// result of the operation, control continues in a new block once the overflow bit is known to be clear
+auto checked_binary(llvm::IRBuilderBase* builder, llvm::Intrinsic::ID id, llvm::Value* lhs, llvm::Value* rhs, const char* name) -> llvm::Value* {
+    llvm::Value* checked = builder->CreateBinaryIntrinsic(id, lhs, rhs);
+    llvm::Value* result = builder->CreateExtractValue(checked, 0, name);
+    llvm::Value* overflow = builder->CreateExtractValue(checked, 1, "overflow");
+
+    llvm::Function* func = builder->GetInsertBlock()->getParent();
+    llvm::BasicBlock* trap = llvm::BasicBlock::Create(builder->getContext(), "overflow_trap", func);
+    llvm::BasicBlock* next = llvm::BasicBlock::Create(builder->getContext(), "no_overflow", func);
+
+    // same weights as __builtin_expect(overflow, 0)
+    builder->CreateCondBr(overflow, trap, next, llvm::MDBuilder{builder->getContext()}.createBranchWeights(1, (1U << 20U) - 1));
+
+    builder->SetInsertPoint(trap);
+    builder->CreateIntrinsic(llvm::Intrinsic::trap, {}, {});
+    builder->CreateUnreachable();
+
+    builder->SetInsertPoint(next);
+    return result;
+}
+
+auto integer_binary(llvm::Instruction::BinaryOps op, bool is_signed, overflow_mode mode, const char* name) -> binary_operator::inserter_wrapper {
+    return [op, is_signed, mode, name] (llvm::IRBuilderBase* builder, llvm::Value* lhs, llvm::Value* rhs) -> llvm::Value* {
+	if(mode == overflow_mode::trap) {
+	    return checked_binary(builder, overflow_intrinsic(op, is_signed), lhs, rhs, name);
+	}
+
+	llvm::Value* result = builder->CreateBinOp(op, lhs, rhs, name);
+	// constants are folded without flags
+	if(auto* inst = llvm::dyn_cast<llvm::BinaryOperator>(result); inst != nullptr && mode == overflow_mode::undefined) {
+	    if(is_signed) {
+		inst->setHasNoSignedWrap();
+	    } else {
+		inst->setHasNoUnsignedWrap();
+	    }
+	}
+	return result;
     };
+}
 
-    auto add_binary = [&functions, &binary] (type::type_id type) {
+} // namespace
+
+
+void ui_addition(special_functions& functions, arithmetic_options options) {
+    auto add_binary = [&functions, &options] (type::type_id type, bool is_signed) {
 	functions.binary("+").insert(type, type, type);
-	functions.binary("+").specialize(type, type, binary);
+	functions.binary("+").specialize(type, type, integer_binary(llvm::Instruction::Add, is_signed, options.mode(is_signed), "add"));
     };
 
-    add_binary(type::type_id::u8 );
-    add_binary(type::type_id::u16);
-    add_binary(type::type_id::u32);
-    add_binary(type::type_id::u64);
+    add_binary(type::type_id::u8,  false);
+    add_binary(type::type_id::u16, false);
+    add_binary(type::type_id::u32, false);
+    add_binary(type::type_id::u64, false);
 
-    add_binary(type::type_id::i8 );
-    add_binary(type::type_id::i16);
-    add_binary(type::type_id::i32);
-    add_binary(type::type_id::i64);
+    add_binary(type::type_id::i8,  true);
+    add_binary(type::type_id::i16, true);
+    add_binary(type::type_id::i32, true);
+    add_binary(type::type_id::i64, true);
 }
 
 void fp_addition(special_functions& functions) {
@@ -41,25 +93,21 @@ void fp_addition(special_functions& functions) {
     add_binary(type::type_id::fp64);
 }
 
-void ui_subtruction(special_functions& functions) {
-    auto binary = [] (llvm::IRBuilderBase* builder, llvm::Value* lhs, llvm::Value* rhs) {
-	return builder->CreateSub(lhs, rhs, "sub");
-    };
-
-    auto add_binary = [&functions, &binary] (type::type_id type) {
+void ui_subtruction(special_functions& functions, arithmetic_options options) {
+    auto add_binary = [&functions, &options] (type::type_id type, bool is_signed) {
 	functions.binary("-").insert(type, type, type);
-	functions.binary("-").specialize(type, type, binary);
+	functions.binary("-").specialize(type, type, integer_binary(llvm::Instruction::Sub, is_signed, options.mode(is_signed), "sub"));
     };
 
-    add_binary(type::type_id::u8 );
-    add_binary(type::type_id::u16);
-    add_binary(type::type_id::u32);
-    add_binary(type::type_id::u64);
+    add_binary(type::type_id::u8,  false);
+    add_binary(type::type_id::u16, false);
+    add_binary(type::type_id::u32, false);
+    add_binary(type::type_id::u64, false);
 
-    add_binary(type::type_id::i8 );
-    add_binary(type::type_id::i16);
-    add_binary(type::type_id::i32);
-    add_binary(type::type_id::i64);
+    add_binary(type::type_id::i8,  true);
+    add_binary(type::type_id::i16, true);
+    add_binary(type::type_id::i32, true);
+    add_binary(type::type_id::i64, true);
 }
 
 void fp_subtruction(special_functions& functions) {
@@ -76,25 +124,21 @@ void fp_subtruction(special_functions& functions) {
     add_binary(type::type_id::fp64);
 }
 
-void ui_multiplication(special_functions& functions) {
-    auto binary = [] (llvm::IRBuilderBase* builder, llvm::Value* lhs, llvm::Value* rhs) {
-	return builder->CreateMul(lhs, rhs, "mul");
-    };
-
-    auto add_binary = [&functions, &binary] (type::type_id type) {
+void ui_multiplication(special_functions& functions, arithmetic_options options) {
+    auto add_binary = [&functions, &options] (type::type_id type, bool is_signed) {
 	functions.binary("*").insert(type, type, type);
-	functions.binary("*").specialize(type, type, binary);
+	functions.binary("*").specialize(type, type, integer_binary(llvm::Instruction::Mul, is_signed, options.mode(is_signed), "mul"));
     };
 
-    add_binary(type::type_id::u8 );
-    add_binary(type::type_id::u16);
-    add_binary(type::type_id::u32);
-    add_binary(type::type_id::u64);
+    add_binary(type::type_id::u8,  false);
+    add_binary(type::type_id::u16, false);
+    add_binary(type::type_id::u32, false);
+    add_binary(type::type_id::u64, false);
 
-    add_binary(type::type_id::i8 );
-    add_binary(type::type_id::i16);
-    add_binary(type::type_id::i32);
-    add_binary(type::type_id::i64);
+    add_binary(type::type_id::i8,  true);
+    add_binary(type::type_id::i16, true);
+    add_binary(type::type_id::i32, true);
+    add_binary(type::type_id::i64, true);
 }
 
 void fp_multiplication(special_functions& functions) {
@@ -204,7 +248,7 @@ void fp_less(special_functions& functions) {
     add_binary(type::type_id::fp64);
 }
 
-void default_binaries(special_functions& functions) {
+void default_binaries(special_functions& functions, arithmetic_options options) {
     functions.new_binary("=", 0);
     functions.new_binary("<", 1);
     functions.new_binary("+", 2);
@@ -216,13 +260,13 @@ void default_binaries(special_functions& functions) {
     i_less(functions);
     fp_less(functions);
 
-    ui_addition(functions);
+    ui_addition(functions, options);
     fp_addition(functions);
 
-    ui_subtruction(functions);
+    ui_subtruction(functions, options);
     fp_subtruction(functions);
 
-    ui_multiplication(functions);
+    ui_multiplication(functions, options);
     fp_multiplication(functions);
 
     u_division(functions);
@@ -0,0 +1,17 @@
+#include <span>
+
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Value.h>
+
+#include "functions.hpp"
+#include "type/type_id.hpp"
+
+
+void default_strings(special_functions& functions) {
+    using arguments = std::span<llvm::Value* const>;
+
+    // the length is part of the slice, no scan for a terminator
+    functions.builtin("len").insert({type::type_id::str}, type::type_id::u64, [] (llvm::IRBuilderBase* builder, arguments args) {
+	return builder->CreateExtractValue(args[0], {1}, "len");
+    });
+}
@@ -0,0 +1,199 @@
+#include <array>
+#include <string>
+#include <vector>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Value.h>
+
+#include "functions.hpp"
+#include "type/type_id.hpp"
+
+
+namespace {
+
+enum class lane_kind {
+    floating,
+    signed_int,
+    unsigned_int,
+};
+
+struct vector_shape {
+    type::type_id vector;
+    type::type_id element;
+    type::type_id mask;
+    unsigned lanes;
+    lane_kind kind;
+};
+
+constexpr std::array<vector_shape, 5> shapes{{
+    {type::type_id::f32x4, type::type_id::fp32, type::type_id::mask4,  4,  lane_kind::floating},
+    {type::type_id::f32x8, type::type_id::fp32, type::type_id::mask8,  8,  lane_kind::floating},
+    {type::type_id::i32x4, type::type_id::i32,  type::type_id::mask4,  4,  lane_kind::signed_int},
+    {type::type_id::i32x8, type::type_id::i32,  type::type_id::mask8,  8,  lane_kind::signed_int},
+    {type::type_id::u8x16, type::type_id::u8,   type::type_id::mask16, 16, lane_kind::unsigned_int},
+}};
+
+constexpr std::array<type::type_id, 3> masks{type::type_id::mask4, type::type_id::mask8, type::type_id::mask16};
+
+auto pick(lane_kind kind, llvm::Instruction::BinaryOps floating, llvm::Instruction::BinaryOps signed_int, llvm::Instruction::BinaryOps unsigned_int) {
+    switch(kind) {
+	case lane_kind::floating:   return floating;
+	case lane_kind::signed_int: return signed_int;
+	default:                    return unsigned_int;
+    }
+}
+
+} // namespace
+
+
+// vector integers wrap around like the SIMD instructions they map to,
+// the overflow mode only applies to scalars
+void vector_arithmetic(special_functions& functions) {
+    auto add_binary = [&functions] (const std::string& oper, const vector_shape& shape, llvm::Instruction::BinaryOps op, const char* name) {
+	functions.binary(oper).insert(shape.vector, shape.vector, shape.vector);
+	functions.binary(oper).specialize(shape.vector, shape.vector, [op, name] (llvm::IRBuilderBase* builder, llvm::Value* lhs, llvm::Value* rhs) {
+	    return builder->CreateBinOp(op, lhs, rhs, name);
+	});
+    };
+
+    for(const vector_shape& shape : shapes) {
+	using ops = llvm::Instruction;
+	add_binary("+", shape, pick(shape.kind, ops::FAdd, ops::Add,  ops::Add),  "add");
+	add_binary("-", shape, pick(shape.kind, ops::FSub, ops::Sub,  ops::Sub),  "sub");
+	add_binary("*", shape, pick(shape.kind, ops::FMul, ops::Mul,  ops::Mul),  "mul");
+	add_binary("/", shape, pick(shape.kind, ops::FDiv, ops::SDiv, ops::UDiv), "div");
+    }
+}
+
+void vector_less(special_functions& functions) {
+    auto predicate = [] (lane_kind kind) {
+	switch(kind) {
+	    case lane_kind::floating:   return llvm::CmpInst::FCMP_OLT;
+	    case lane_kind::signed_int: return llvm::CmpInst::ICMP_SLT;
+	    default:                    return llvm::CmpInst::ICMP_ULT;
+	}
+    };
+
+    for(const vector_shape& shape : shapes) {
+	functions.binary("<").insert(shape.vector, shape.vector, shape.mask);
+	functions.binary("<").specialize(shape.vector, shape.vector, [pred = predicate(shape.kind)] (llvm::IRBuilderBase* builder, llvm::Value* lhs, llvm::Value* rhs) {
+	    return builder->CreateCmp(pred, lhs, rhs, "less");
+	});
+    }
+}
+
+void vector_casts(special_functions& functions, type::registry& types) {
+    // literals become splat constants, "v * 2.0" scales every lane
+    for(const vector_shape& shape : shapes) {
+	if(shape.kind == lane_kind::floating) {
+	    functions.cast(type::type_id::fp_literal).insert(shape.vector);
+	} else {
+	    functions.cast(type::type_id::u_literal).insert(shape.vector);
+	}
+    }
+
+    auto add_cast = [&functions, &types] (type::type_id from_type, type::type_id to_type) {
+	functions.cast(from_type).specialize(to_type, [to_type = **types.get(to_type)] (llvm::IRBuilderBase* builder, llvm::Value* value) {
+	    return builder->CreateSIToFP(value, to_type, "cast");
+	});
+    };
+
+    add_cast(type::type_id::i32x4, type::type_id::f32x4);
+    add_cast(type::type_id::i32x8, type::type_id::f32x8);
+}
+
+void vector_builtins(special_functions& functions, type::registry& types) {
+    using arguments = std::span<llvm::Value* const>;
+
+    for(const vector_shape& shape : shapes) {
+	const unsigned lanes = shape.lanes;
+	const bool floating = shape.kind == lane_kind::floating;
+	const bool is_signed = shape.kind == lane_kind::signed_int;
+
+	// splat4(x: f32) -> f32x4, the lane count picks the vector
+	functions.builtin("splat" + std::to_string(lanes)).insert({shape.element}, shape.vector, [lanes] (llvm::IRBuilderBase* builder, arguments args) {
+	    return builder->CreateVectorSplat(lanes, args[0], "splat");
+	});
+
+	// lane numbers wrap around, every lane count is a power of two
+	functions.builtin("extract").insert({shape.vector, type::type_id::u32}, shape.element, [lanes] (llvm::IRBuilderBase* builder, arguments args) {
+	    return builder->CreateExtractElement(args[0], builder->CreateAnd(args[1], lanes - 1), "lane");
+	});
+	functions.builtin("insert").insert({shape.vector, type::type_id::u32, shape.element}, shape.vector, [lanes] (llvm::IRBuilderBase* builder, arguments args) {
+	    return builder->CreateInsertElement(args[0], args[2], builder->CreateAnd(args[1], lanes - 1), "insert");
+	});
+
+	// shuffle(a, b, [0, 4, 1, 5]) picks lanes of a, then of b, the pattern has to be constant
+	type::type_id pattern_t = types.id(type::type_id::u32, lanes);
+	functions.builtin("shuffle").insert({shape.vector, shape.vector, pattern_t}, shape.vector, [lanes] (llvm::IRBuilderBase* builder, arguments args) -> llvm::Value* {
+	    auto* pattern = llvm::dyn_cast<llvm::Constant>(args[2]);
+	    if(pattern == nullptr) {
+		return nullptr;
+	    }
+
+	    std::vector<int> mask(lanes);
+	    for(unsigned i = 0; i < lanes; ++i) {
+		auto* lane = llvm::dyn_cast_or_null<llvm::ConstantInt>(pattern->getAggregateElement(i));
+		if(lane == nullptr || lane->getZExtValue() >= 2 * lanes) {
+		    return nullptr;
+		}
+		mask[i] = static_cast<int>(lane->getZExtValue());
+	    }
+	    return builder->CreateShuffleVector(args[0], args[1], mask, "shuffle");
+	});
+
+	// blend(a, b, mask) takes the lanes of b where the mask is set
+	functions.builtin("blend").insert({shape.vector, shape.vector, shape.mask}, shape.vector, [] (llvm::IRBuilderBase* builder, arguments args) {
+	    return builder->CreateSelect(args[2], args[1], args[0], "blend");
+	});
+
+	// horizontal reductions, float sums and products keep lane order unless reassoc is allowed
+	functions.builtin("reduce_add").insert({shape.vector}, shape.element, [floating, element = **types.get(shape.element)] (llvm::IRBuilderBase* builder, arguments args) {
+	    return floating ? builder->CreateFAddReduce(llvm::ConstantFP::getNegativeZero(element), args[0]) : builder->CreateAddReduce(args[0]);
+	});
+	functions.builtin("reduce_mul").insert({shape.vector}, shape.element, [floating, element = **types.get(shape.element)] (llvm::IRBuilderBase* builder, arguments args) {
+	    return floating ? builder->CreateFMulReduce(llvm::ConstantFP::get(element, 1.0), args[0]) : builder->CreateMulReduce(args[0]);
+	});
+	functions.builtin("reduce_min").insert({shape.vector}, shape.element, [floating, is_signed] (llvm::IRBuilderBase* builder, arguments args) {
+	    return floating ? builder->CreateFPMinReduce(args[0]) : builder->CreateIntMinReduce(args[0], is_signed);
+	});
+	functions.builtin("reduce_max").insert({shape.vector}, shape.element, [floating, is_signed] (llvm::IRBuilderBase* builder, arguments args) {
+	    return floating ? builder->CreateFPMaxReduce(args[0]) : builder->CreateIntMaxReduce(args[0], is_signed);
+	});
+
+	// arrays and vectors of the same shape convert both ways
+	type::type_id array_t = types.id(shape.element, lanes);
+	functions.builtin("to_vector").insert({array_t}, shape.vector, [lanes, vector_t = **types.get(shape.vector)] (llvm::IRBuilderBase* builder, arguments args) {
+	    llvm::Value* vector = llvm::PoisonValue::get(vector_t);
+	    for(unsigned i = 0; i < lanes; ++i) {
+		vector = builder->CreateInsertElement(vector, builder->CreateExtractValue(args[0], {i}), builder->getInt32(i));
+	    }
+	    return vector;
+	});
+	functions.builtin("to_array").insert({shape.vector}, array_t, [lanes, array_t = **types.get(array_t)] (llvm::IRBuilderBase* builder, arguments args) {
+	    llvm::Value* array = llvm::PoisonValue::get(array_t);
+	    for(unsigned i = 0; i < lanes; ++i) {
+		array = builder->CreateInsertValue(array, builder->CreateExtractElement(args[0], builder->getInt32(i)), {i});
+	    }
+	    return array;
+	});
+    }
+
+    for(type::type_id mask : masks) {
+	functions.builtin("any").insert({mask}, type::type_id::bool_, [] (llvm::IRBuilderBase* builder, arguments args) {
+	    return builder->CreateOrReduce(args[0]);
+	});
+	functions.builtin("all").insert({mask}, type::type_id::bool_, [] (llvm::IRBuilderBase* builder, arguments args) {
+	    return builder->CreateAndReduce(args[0]);
+	});
+    }
+}
+
+void default_vectors(special_functions& functions, type::registry& types) {
+    vector_arithmetic(functions);
+    vector_less(functions);
+    vector_casts(functions, types);
+    vector_builtins(functions, types);
+}
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include "call_graph.hpp"
+#include "export_policy.hpp"
+
+
+auto export_policy::is_root(const function_info& info) const -> bool {
+    return info.exported || info.name == "main" || _names.contains(info.name);
+}
+
+void export_policy::mark(std::span<function_info> functions) const {
+    bool library = std::ranges::none_of(functions, [this] (const function_info& info) { return is_root(info); });
+
+    for(function_info& info : functions) {
+	info.exported = library || is_root(info);
+    }
+}
+
+auto export_policy::prune(file_node& node) const -> std::size_t {
+    std::vector<std::size_t> roots{};
+    for(std::size_t index = 0; index < node.children_size(); ++index) {
+	if(is_root(std::any_cast<const function_node&>(node.children()[index]).payload())) {
+	    roots.push_back(index);
+	}
+    }
+
+    if(roots.empty()) {
+	for(std::any& child : node.children()) {
+	    std::any_cast<function_node&>(child).payload().exported = true;
+	}
+	return 0;
+    }
+
+    std::vector<bool> reachable = call_graph{node}.reachable(roots);
+    for(std::size_t index : roots) {
+	std::any_cast<function_node&>(node.children()[index]).payload().exported = true;
+    }
+
+    // reachable functions are moved to the front in order, a plain index loop
+    // since remove_if does not promise to call its predicate once per element in order
+    std::size_t kept{};
+    for(std::size_t index = 0; index < node.children_size(); ++index) {
+	if(!reachable[index]) {
+	    continue;
+	}
+	if(kept != index) {
+	    node.children()[kept] = std::move(node.children()[index]);
+	}
+	++kept;
+    }
+
+    std::size_t count = node.children_size() - kept;
+    node.children().erase(node.children().begin() + static_cast<std::ptrdiff_t>(kept), node.children().end());
+
+    return count;
+}
@@ -52,6 +52,50 @@ void binary_operator::specialize(type::type_id left, type::type_id right, insert
     _binary[std::make_pair(left, right)].inserter = std::move(inserter);
 }
 
+auto builtin_function::get(type::type_id first) const -> const overload* {
+    if(auto iter = _overloads.find(first); iter != _overloads.end()) {
+	return &iter->second;
+    }
+    return nullptr;
+}
+
+void builtin_function::insert(std::vector<type::type_id> params, type::type_id return_type, inserter_wrapper inserter) {
+    type::type_id first = params.front();
+    _overloads[first] = {std::move(params), return_type, std::move(inserter)};
+}
+
+auto special_functions::cast(type::type_id from_type) const noexcept -> const casts& {
+    static const casts empty{};
+    if(auto iter = _casts.find(from_type); iter != _casts.end()) {
+	return iter->second;
+    }
+    return empty;
+}
+
+auto special_functions::unary(const std::string& oper) const noexcept -> const unary_operator& {
+    static const unary_operator empty{};
+    if(auto iter = _unary.find(oper); iter != _unary.end()) {
+	return iter->second;
+    }
+    return empty;
+}
+
+auto special_functions::binary(const std::string& oper) const noexcept -> const binary_operator& {
+    static const binary_operator empty{};
+    if(auto iter = _binary.find(oper); iter != _binary.end()) {
+	return iter->second;
+    }
+    return empty;
+}
+
+auto special_functions::builtin(const std::string& name) const noexcept -> const builtin_function& {
+    static const builtin_function empty{};
+    if(auto iter = _builtins.find(name); iter != _builtins.end()) {
+	return iter->second;
+    }
+    return empty;
+}
+
 auto special_functions::new_unary(const std::string& oper, std::uint64_t precedense) noexcept -> bool {
     auto& unary_oper = _unary[oper];
     if(unary_oper.precedense() != 0U) {
@@ -0,0 +1,479 @@
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "interpreter.hpp"
+
+
+namespace {
+
+auto width(type::type_id tid) -> unsigned {
+    switch(tid) {
+	case type::type_id::bool_: return 1;
+	case type::type_id::char_:
+	case type::type_id::u8:
+	case type::type_id::i8:    return 8;
+	case type::type_id::u16:
+	case type::type_id::i16:   return 16;
+	case type::type_id::u32:
+	case type::type_id::i32:   return 32;
+	case type::type_id::u64:
+	case type::type_id::i64:   return 64;
+	default:                   return 0;
+    }
+}
+
+auto is_floating(type::type_id tid) -> bool {
+    return tid == type::type_id::fp32 || tid == type::type_id::fp64;
+}
+
+auto truncate(std::uint64_t value, unsigned bits) -> std::uint64_t {
+    return bits >= 64 ? value : value & ((std::uint64_t{1} << bits) - 1);
+}
+
+auto sign_extend(std::uint64_t value, unsigned bits) -> std::int64_t {
+    unsigned shift = 64 - bits;
+    return static_cast<std::int64_t>(value << shift) >> shift;
+}
+
+auto make_integer(type::type_id tid, std::uint64_t value) -> constant {
+    return {tid, truncate(value, width(tid)), 0.0};
+}
+
+auto make_floating(type::type_id tid, double value) -> std::optional<constant> {
+    if(tid == type::type_id::fp32) {
+	value = static_cast<float>(value);
+    }
+    // nnan and ninf would make these poison, without them they are fine but rare enough to leave alone
+    if(!std::isfinite(value)) {
+	return {};
+    }
+    return constant{tid, 0, value};
+}
+
+auto integer_arithmetic(const std::string& oper, constant lhs, constant rhs, overflow_mode mode) -> std::optional<constant> {
+    type::type_id tid = lhs.type;
+    unsigned bits = width(tid);
+
+    if(type::is_signed(tid)) {
+	std::int64_t a = sign_extend(lhs.integer, bits);
+	std::int64_t b = sign_extend(rhs.integer, bits);
+
+	if(oper == "<") {
+	    return make_integer(type::type_id::bool_, a < b);
+	}
+	if(oper == "/") {
+	    if(b == 0 || (b == -1 && a == sign_extend(std::uint64_t{1} << (bits - 1), bits))) {
+		return {};
+	    }
+	    return make_integer(tid, static_cast<std::uint64_t>(a / b));
+	}
+
+	std::int64_t result{};
+	bool overflow = false;
+	if(oper == "+") {
+	    overflow = __builtin_add_overflow(a, b, &result);
+	} else if(oper == "-") {
+	    overflow = __builtin_sub_overflow(a, b, &result);
+	} else if(oper == "*") {
+	    overflow = __builtin_mul_overflow(a, b, &result);
+	} else {
+	    return {};
+	}
+
+	overflow = overflow || sign_extend(truncate(static_cast<std::uint64_t>(result), bits), bits) != result;
+	if(overflow && mode != overflow_mode::wrap) {
+	    return {};
+	}
+	return make_integer(tid, static_cast<std::uint64_t>(result));
+    }
+
+    std::uint64_t a = lhs.integer;
+    std::uint64_t b = rhs.integer;
+
+    if(oper == "<") {
+	return make_integer(type::type_id::bool_, a < b);
+    }
+    if(oper == "/") {
+	if(b == 0) {
+	    return {};
+	}
+	return make_integer(tid, a / b);
+    }
+
+    std::uint64_t result{};
+    bool overflow = false;
+    if(oper == "+") {
+	overflow = __builtin_add_overflow(a, b, &result);
+    } else if(oper == "-") {
+	overflow = __builtin_sub_overflow(a, b, &result);
+    } else if(oper == "*") {
+	overflow = __builtin_mul_overflow(a, b, &result);
+    } else {
+	return {};
+    }
+
+    overflow = overflow || truncate(result, bits) != result;
+    if(overflow && mode != overflow_mode::wrap) {
+	return {};
+    }
+    return make_integer(tid, result);
+}
+
+auto floating_arithmetic(const std::string& oper, constant lhs, constant rhs) -> std::optional<constant> {
+    type::type_id tid = lhs.type;
+
+    if(oper == "<") {
+	return make_integer(type::type_id::bool_, lhs.floating < rhs.floating);
+    }
+
+    // fp32 operations round once, like the float instructions
+    auto apply = [&oper] <typename T> (T a, T b) -> std::optional<double> {
+	if(oper == "+") { return a + b; }
+	if(oper == "-") { return a - b; }
+	if(oper == "*") { return a * b; }
+	if(oper == "/") { return a / b; }
+	return {};
+    };
+
+    std::optional<double> result = tid == type::type_id::fp32
+	? apply(static_cast<float>(lhs.floating), static_cast<float>(rhs.floating))
+	: apply(lhs.floating, rhs.floating);
+    if(!result.has_value()) {
+	return {};
+    }
+    return make_floating(tid, *result);
+}
+
+} // namespace
+
+
+auto interpreter::run(std::size_t index, std::span<const constant> arguments) -> std::optional<constant> {
+    if(_options.step_budget == 0 || index >= _file->children_size()) {
+	return {};
+    }
+
+    _steps = 0;
+    _depth = 0;
+    _returned.reset();
+    _values.clear();
+
+    return invoke(std::any_cast<const function_node&>(_file->children()[index]), arguments);
+}
+
+auto interpreter::evaluate(const std::any& node) -> std::optional<constant> {
+    if(++_steps > _options.step_budget) {
+	return {};
+    }
+    return any_tree::visit_node(_visitor, node);
+}
+
+auto interpreter::statements(std::span<const std::any> nodes) -> std::optional<constant> {
+    std::optional<constant> last = constant{type::type_id::void_};
+    for(const std::any& node : nodes) {
+	last = evaluate(node);
+	if(!last.has_value() || _returned.has_value()) {
+	    return last;
+	}
+    }
+    return last;
+}
+
+auto interpreter::invoke(const function_node& node, std::span<const constant> arguments) -> std::optional<constant> {
+    const function_info& info = node.payload();
+    if(!info.attributes.pure || arguments.size() != info.params.size() || _depth >= _options.max_depth) {
+	return {};
+    }
+
+    for(std::size_t i = 0; i < arguments.size(); ++i) {
+	if(arguments[i].type != info.params_type[i]) {
+	    return {};
+	}
+    }
+
+    ++_depth;
+    scope_pusher pusher{&_scope, &node};
+    for(std::size_t i = 0; i < arguments.size(); ++i) {
+	_scope.add(info.params[i], &_values.emplace_back(arguments[i]));
+    }
+
+    std::optional<constant> body = evaluate(node.child_at(0));
+    --_depth;
+
+    std::optional<constant> result = std::exchange(_returned, std::nullopt);
+    if(!body.has_value()) {
+	return {};
+    }
+    if(info.return_type == type::type_id::void_) {
+	return constant{type::type_id::void_};
+    }
+    // falling off the end of a function with a result is unreachable
+    if(!result.has_value() || result->type != info.return_type) {
+	return {};
+    }
+    return result;
+}
+
+auto interpreter::return_statement(const return_statement_node& node) -> std::optional<constant> {
+    std::optional<constant> value = evaluate(node.child_at(0));
+    if(value.has_value()) {
+	_returned = value;
+    }
+    return value;
+}
+
+auto interpreter::var_def(const var_def_node& node) -> std::optional<constant> {
+    std::optional<constant> value{};
+    if(!node.children().empty()) {
+	value = evaluate(node.child_at(0));
+	if(!value.has_value() || value->type != node.payload().type) {
+	    return {};
+	}
+    }
+
+    _scope.add(node.payload().name, &_values.emplace_back(value));
+    return value.value_or(constant{type::type_id::void_});
+}
+
+auto interpreter::binary_expr(const binary_expr_node& node) -> std::optional<constant> {
+    if(node.payload().oper == "=") {
+	const auto* name = std::any_cast<identifier_node>(&node.child_at(0));
+	if(name == nullptr) {
+	    return {};
+	}
+
+	std::optional<constant>* variable = _scope.get(name->payload()).value_or(nullptr);
+	std::optional<constant> value = evaluate(node.child_at(1));
+	if(variable == nullptr || !value.has_value()) {
+	    return {};
+	}
+	return *variable = value;
+    }
+
+    std::optional<constant> lhs = evaluate(node.child_at(0));
+    if(!lhs.has_value()) {
+	return {};
+    }
+    std::optional<constant> rhs = evaluate(node.child_at(1));
+    if(!rhs.has_value()) {
+	return {};
+    }
+
+    return binary(node.payload().oper, *lhs, *rhs, node.payload().lhs, _options.arithmetic);
+}
+
+auto interpreter::if_stmt(const if_node& node) -> std::optional<constant> {
+    scope_pusher pusher{&_scope};
+
+    if(node.payload().has_let && !evaluate(node.child_at(0)).has_value()) {
+	return {};
+    }
+
+    std::optional<constant> cond = evaluate(node.child_at(1));
+    if(!cond.has_value()) {
+	return {};
+    }
+    if(cond->integer == 0) {
+	return constant{type::type_id::void_};
+    }
+    return evaluate(node.child_at(2));
+}
+
+auto interpreter::if_else(const auto& node) -> std::optional<constant> {
+    scope_pusher pusher{&_scope};
+
+    if(node.payload().has_let && !evaluate(node.child_at(0)).has_value()) {
+	return {};
+    }
+
+    std::optional<constant> cond = evaluate(node.child_at(1));
+    if(!cond.has_value()) {
+	return {};
+    }
+    // the value of the taken block, an if expression yields it
+    return evaluate(node.child_at(cond->integer != 0 ? 2 : 3));
+}
+
+auto interpreter::loop_stmt(const loop_node& node) -> std::optional<constant> {
+    scope_pusher pusher{&_scope};
+
+    if(const auto& let = node.child_at(0); let.has_value() && !evaluate(let).has_value()) {
+	return {};
+    }
+
+    // runs until the condition fails, a return, or the budget is used up
+    while(true) {
+	if(const auto& condition = node.child_at(1); condition.has_value()) {
+	    std::optional<constant> cond = evaluate(condition);
+	    if(!cond.has_value()) {
+		return {};
+	    }
+	    if(cond->integer == 0) {
+		return constant{type::type_id::void_};
+	    }
+	}
+
+	std::optional<constant> body = evaluate(node.child_at(3));
+	if(!body.has_value() || _returned.has_value()) {
+	    return body;
+	}
+
+	if(const auto& post = node.child_at(2); post.has_value() && !evaluate(post).has_value()) {
+	    return {};
+	}
+    }
+}
+
+auto interpreter::call(const call_node& node) -> std::optional<constant> {
+    if(node.payload().builtin != nullptr || node.payload().callee_index >= _file->children_size()) {
+	return {};
+    }
+
+    std::vector<constant> arguments{};
+    arguments.reserve(node.children_size());
+    for(const std::any& child : node.children()) {
+	std::optional<constant> argument = evaluate(child);
+	if(!argument.has_value()) {
+	    return {};
+	}
+	arguments.push_back(*argument);
+    }
+
+    return invoke(std::any_cast<const function_node&>(_file->children()[node.payload().callee_index]), arguments);
+}
+
+auto interpreter::implicit_cast(const implicit_cast_node& node) -> std::optional<constant> {
+    std::optional<constant> value = evaluate(node.child_at(0));
+    if(!value.has_value() || value->type != node.payload().from_type) {
+	return {};
+    }
+    return cast(*value, node.payload().to_type);
+}
+
+auto interpreter::identifier(const identifier_node& node) -> std::optional<constant> {
+    std::optional<constant>* variable = _scope.get(node.payload()).value_or(nullptr);
+    if(variable == nullptr) {
+	return {};
+    }
+    return *variable;
+}
+
+auto interpreter::binary(const std::string& oper, constant lhs, constant rhs, type::type_id type, arithmetic_options arithmetic) -> std::optional<constant> {
+    if(lhs.type != type || rhs.type != type) {
+	return {};
+    }
+    if(is_floating(type)) {
+	return floating_arithmetic(oper, lhs, rhs);
+    }
+    if(type::is_integer(type)) {
+	return integer_arithmetic(oper, lhs, rhs, arithmetic.mode(type::is_signed(type)));
+    }
+    return {};
+}
+
+auto interpreter::cast(constant value, type::type_id to_type) -> std::optional<constant> {
+    type::type_id from_type = value.type;
+
+    if(to_type == type::type_id::bool_) {
+	if(is_floating(from_type)) {
+	    return make_integer(to_type, !std::isnan(value.floating) && value.floating != 0.0);
+	}
+	return make_integer(to_type, value.integer != 0);
+    }
+
+    if(is_floating(from_type)) {
+	return is_floating(to_type) ? make_floating(to_type, value.floating) : std::nullopt;
+    }
+
+    if(is_floating(to_type)) {
+	if(type::is_signed(from_type)) {
+	    std::int64_t integer = sign_extend(value.integer, width(from_type));
+	    return to_type == type::type_id::fp32 ? make_floating(to_type, static_cast<float>(integer)) : make_floating(to_type, static_cast<double>(integer));
+	}
+	return to_type == type::type_id::fp32 ? make_floating(to_type, static_cast<float>(value.integer)) : make_floating(to_type, static_cast<double>(value.integer));
+    }
+
+    if(width(to_type) == 0) {
+	return {};
+    }
+    if(type::is_signed(from_type)) {
+	return make_integer(to_type, static_cast<std::uint64_t>(sign_extend(value.integer, width(from_type))));
+    }
+    return make_integer(to_type, value.integer);
+}
+
+auto interpreter::from_literal(const std::any& node) -> std::optional<constant> {
+    if(const auto* integer = std::any_cast<integer_literal_node>(&node); integer != nullptr) {
+	type::type_id tid = type::default_type(integer->payload().type);
+	if(is_floating(tid)) {
+	    return make_floating(tid, static_cast<double>(integer->payload().value));
+	}
+	if(width(tid) == 0) {
+	    return {};
+	}
+	return make_integer(tid, integer->payload().value);
+    }
+    if(const auto* floating = std::any_cast<floating_literal_node>(&node); floating != nullptr) {
+	type::type_id tid = type::default_type(floating->payload().type);
+	return is_floating(tid) ? make_floating(tid, floating->payload().value) : std::nullopt;
+    }
+    if(const auto* character = std::any_cast<char_literal_node>(&node); character != nullptr) {
+	return make_integer(type::type_id::char_, static_cast<unsigned char>(character->payload().value));
+    }
+    if(const auto* boolean = std::any_cast<bool_literal_node>(&node); boolean != nullptr) {
+	return make_integer(type::type_id::bool_, boolean->payload().value);
+    }
+    return {};
+}
+
+auto interpreter::to_literal(constant value) -> std::any {
+    switch(value.type) {
+	case type::type_id::bool_:
+	    return bool_literal_node{literal<bool>{value.integer != 0, value.type}};
+	case type::type_id::char_:
+	    return char_literal_node{literal<char>{static_cast<char>(value.integer), value.type}};
+	case type::type_id::fp32:
+	case type::type_id::fp64:
+	    return floating_literal_node{literal<double>{value.floating, value.type}};
+	default:
+	    if(width(value.type) == 0) {
+		return {};
+	    }
+	    return integer_literal_node{literal<std::uint64_t>{value.integer, value.type}};
+    }
+}
+
+interpreter::interpreter(const file_node* file, interpreter_options options)
+    : _file{file}
+    , _options{options}
+{
+    auto literal_value = [] (const auto& node) { return from_literal(std::any{node}); };
+
+    _visitor = {
+	any_tree::make_const_child_visitor<return_statement_node>([this] (const return_statement_node& node) { return return_statement(node); }),
+	any_tree::make_const_child_visitor<let_statement_node>   ([this] (const let_statement_node& node)    { return statements(node.children()); }),
+	any_tree::make_const_child_visitor<var_def_node>         ([this] (const var_def_node& node)          { return var_def(node); }),
+	any_tree::make_const_child_visitor<binary_expr_node>     ([this] (const binary_expr_node& node)      { return binary_expr(node); }),
+	any_tree::make_const_child_visitor<if_node>              ([this] (const if_node& node)               { return if_stmt(node); }),
+	any_tree::make_const_child_visitor<if_else_node>         ([this] (const if_else_node& node)          { return if_else(node); }),
+	any_tree::make_const_child_visitor<if_else_expr_node>    ([this] (const if_else_expr_node& node)     { return if_else(node); }),
+	any_tree::make_const_child_visitor<loop_node>            ([this] (const loop_node& node)             { return loop_stmt(node); }),
+	any_tree::make_const_child_visitor<block_node>           ([this] (const block_node& node)            { return statements(node.children()); }),
+	any_tree::make_const_child_visitor<call_node>            ([this] (const call_node& node)             { return call(node); }),
+	any_tree::make_const_child_visitor<implicit_cast_node>   ([this] (const implicit_cast_node& node)    { return implicit_cast(node); }),
+	any_tree::make_const_child_visitor<identifier_node>      ([this] (const identifier_node& node)       { return identifier(node); }),
+	any_tree::make_const_child_visitor<integer_literal_node> (literal_value),
+	any_tree::make_const_child_visitor<floating_literal_node>(literal_value),
+	any_tree::make_const_child_visitor<char_literal_node>    (literal_value),
+	any_tree::make_const_child_visitor<bool_literal_node>    (literal_value),
+	// no aggregates, strings or functions as values
+	any_tree::make_const_child_visitor<string_literal_node>  ([] (const string_literal_node&)   { return std::optional<constant>{}; }),
+	any_tree::make_const_child_visitor<array_literal_node>   ([] (const array_literal_node&)    { return std::optional<constant>{}; }),
+	any_tree::make_const_child_visitor<index_node>           ([] (const index_node&)            { return std::optional<constant>{}; }),
+	any_tree::make_const_child_visitor<struct_literal_node>  ([] (const struct_literal_node&)   { return std::optional<constant>{}; }),
+	any_tree::make_const_child_visitor<field_node>           ([] (const field_node&)            { return std::optional<constant>{}; }),
+	any_tree::make_const_child_visitor<void>                 ([] () { return std::optional<constant>{}; }),
+    };
+}
+
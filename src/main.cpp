@@ -1,7 +1,17 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
 #include <format>
 #include <iostream>
 #include <fstream>
-
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <llvm/ADT/StringMap.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/PassManager.h>
 #include <llvm/IR/LegacyPassManager.h>
@@ -9,7 +19,9 @@
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Support/CodeGen.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/PGOOptions.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/VirtualFileSystem.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
@@ -22,10 +34,16 @@
 #include "any_tree/visitor.hpp"
 #include "tree.hpp"
 #include "type/type_id.hpp"
+#include "type/interner.hpp"
 #include "type/registry.hpp"
 #include "functions.hpp"
 #include "semantic_analyzer.hpp"
+#include "attribute_inference.hpp"
+#include "constant_folding.hpp"
+#include "thread_pool.hpp"
 #include "code_generator.hpp"
+#include "pipeline.hpp"
+#include "export_policy.hpp"
 
 
 void tabs(std::size_t n) {
@@ -38,20 +56,287 @@ auto operator<<(std::ostream& out, type::type_id tid) -> std::ostream& {
     return out << static_cast<std::underlying_type_t<type::type_id>>(tid);
 }
 
+// cpu is a cpu name, or "native" for the host cpu with the features it
+// reports, like the fma and avx2 that contraction and wide reductions need.
+// function_sections puts every function in a section of its own, which is
+// the unit a linker reorders by an order file
+auto make_target_machine(const std::string& cpu, bool function_sections) -> std::unique_ptr<llvm::TargetMachine> {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmParsers();
+    llvm::InitializeAllAsmPrinters();
+
+    std::string target_triple = llvm::sys::getDefaultTargetTriple();
+
+    std::string error;
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(target_triple, error);
+    if(!target) {
+	llvm::errs() << error;
+	return nullptr;
+    }
+
+    std::string cpu_name = cpu;
+    std::string features{};
+    if(cpu == "native") {
+	cpu_name = llvm::sys::getHostCPUName().str();
+
+	llvm::StringMap<bool> host_features{};
+	if(llvm::sys::getHostCPUFeatures(host_features)) {
+	    for(const auto& feature : host_features) {
+		features += std::format("{}{}{}", features.empty() ? "" : ",", feature.getValue() ? '+' : '-', std::string_view{feature.getKey()});
+	    }
+	}
+    }
+
+    llvm::TargetOptions opt;
+    opt.FunctionSections = function_sections;
+    //auto rm = std::optional<llvm::Reloc::Model>();
+    return std::unique_ptr<llvm::TargetMachine>{target->createTargetMachine(target_triple, cpu_name, features, opt, {})};
+}
+
+auto emit(llvm::Module& module, llvm::TargetMachine* target_machine, const std::string& input) -> int {
+    std::string filename = input + ".o";
+    std::error_code error_code;
+    llvm::raw_fd_ostream dest(filename, error_code, llvm::sys::fs::OF_None);
+
+    if (error_code) {
+	llvm::errs() << "Could not open file: " << error_code.message();
+        return 1;
+    }
+    
+    llvm::legacy::PassManager pass;
+    auto filetype = llvm::CodeGenFileType::CGFT_ObjectFile;
+    if(target_machine->addPassesToEmitFile(pass, dest, nullptr, filetype)) {
+	std::cerr << "target machine cannot emit files of this type";
+	return 1;
+    }
+
+    pass.run(module);
+    dest.flush();
+
+    std::cout << std::format("Wrote {}\n", filename);
+
+    return 0;
+}
+
+// symbol ordering file for the linker (lld --symbol-ordering-file, gold
+// --section-ordering-file), needs the object built with function sections.
+// hot functions come first, then the ones a profile saw called, most called
+// first, then the rest in module order and cold or never called ones last
+auto write_order_file(const llvm::Module& module, const std::string& filename) -> int {
+    std::vector<const llvm::Function*> functions{};
+    for(const llvm::Function& func : module) {
+	if(!func.isDeclaration()) {
+	    functions.push_back(&func);
+	}
+    }
+
+    // entry counts are only there with --profile-use
+    auto calls = [] (const llvm::Function* func) -> std::optional<std::uint64_t> {
+	if(auto count = func->getEntryCount(); count.has_value()) {
+	    return count->getCount();
+	}
+	return {};
+    };
+    auto rank = [&calls] (const llvm::Function* func) {
+	std::optional<std::uint64_t> count = calls(func);
+	if(func->hasFnAttribute(llvm::Attribute::Hot)) {
+	    return 0;
+	}
+	if(func->hasFnAttribute(llvm::Attribute::Cold) || count == 0U) {
+	    return 3;
+	}
+	return count.has_value() ? 1 : 2;
+    };
+
+    std::ranges::stable_sort(functions, [&rank, &calls] (const llvm::Function* lhs, const llvm::Function* rhs) {
+	if(rank(lhs) != rank(rhs)) {
+	    return rank(lhs) < rank(rhs);
+	}
+	return calls(lhs).value_or(0) > calls(rhs).value_or(0);
+    });
+
+    std::ofstream out{filename};
+    if(!out) {
+	std::cerr << std::format("Could not open file: {}\n", filename);
+	return 1;
+    }
+
+    for(const llvm::Function* func : functions) {
+	out << std::string_view{func->getName()} << '\n';
+    }
+
+    std::cout << std::format("Wrote {}\n", filename);
+    return 0;
+}
+
+struct options {
+    std::string input{};
+    // -march=, "generic" runs on every cpu of the target
+    std::string cpu{"generic"};
+    // stream functions through the stages instead of running them one after another
+    bool pipelined{};
+    std::size_t jobs{std::max(std::thread::hardware_concurrency(), 1U)};
+    llvm::OptimizationLevel level{llvm::OptimizationLevel::O1};
+    codegen_options codegen{};
+    arithmetic_options arithmetic{};
+    // compile-time evaluation of pure calls, constant folding itself is always on
+    interpreter_options interpreter{};
+    // lay out struct fields to minimize padding, "structReorder" does it per struct
+    bool reorder_fields{};
+    // kept external in addition to main and functions marked in the source
+    std::vector<std::string> exports{};
+    // where to write the function order for the linker, nothing is written when empty
+    std::string order_file{};
+    // instrument for profiling, the value is the .profraw name pattern the program writes to
+    std::optional<std::string> profile_generate{};
+    // counts merged by llvm-profdata drive inlining, block layout and branch weights
+    std::string profile_use{};
+};
+
+auto pgo_options(const options& opts) -> std::optional<llvm::PGOOptions> {
+    if(opts.profile_generate.has_value()) {
+	return llvm::PGOOptions{*opts.profile_generate, "", "", "", llvm::vfs::getRealFileSystem(), llvm::PGOOptions::IRInstr};
+    }
+    if(!opts.profile_use.empty()) {
+	return llvm::PGOOptions{opts.profile_use, "", "", "", llvm::vfs::getRealFileSystem(), llvm::PGOOptions::IRUse};
+    }
+    return {};
+}
+
+auto parse_options(int argc, char** argv) -> std::optional<options> {
+    options result{};
+    // asked for on the command line, not just the default budget
+    bool constexpr_steps = false;
+
+    for(int i = 1; i < argc; ++i) {
+	std::string_view arg{argv[i]};
+
+	if(arg == "--pipeline") {
+	    result.pipelined = true;
+	} else if(arg == "-O0") {
+	    result.level = llvm::OptimizationLevel::O0;
+	} else if(arg == "-O1") {
+	    result.level = llvm::OptimizationLevel::O1;
+	} else if(arg == "-O2") {
+	    result.level = llvm::OptimizationLevel::O2;
+	} else if(arg.starts_with("-march=") && arg.size() > 7) {
+	    result.cpu = arg.substr(7);
+	} else if(arg == "-O3") {
+	    result.level = llvm::OptimizationLevel::O3;
+	} else if(arg == "-g" || arg == "-gline-tables-only") {
+	    // line tables are all there is, -g is accepted for build systems that pass it
+	    result.codegen.line_tables = true;
+	} else if(arg == "-fno-ssa") {
+	    result.codegen.ssa = false;
+	} else if(arg == "-ffast-math") {
+	    result.codegen.fast_math = fp_flags::fast;
+	} else if(arg.starts_with("-ffp=")) {
+	    // e.g. -ffp=reassoc,contract
+	    auto flags = parse_fp_flags(arg.substr(5));
+	    if(!flags.has_value()) {
+		return {};
+	    }
+	    result.codegen.fast_math |= *flags;
+	} else if(arg == "-fwrapv") {
+	    result.arithmetic.overflow = overflow_mode::wrap;
+	} else if(arg == "-fno-unsigned-wrap") {
+	    result.arithmetic.unsigned_undefined = true;
+	} else if(arg == "-ftrapv") {
+	    result.arithmetic.overflow = overflow_mode::trap;
+	} else if(arg == "-ftail-loops") {
+	    result.codegen.tail_loops = true;
+	} else if(arg == "-fno-bounds-checks") {
+	    result.codegen.bounds_checks = false;
+	} else if(arg.starts_with("-fconstexpr-steps=")) {
+	    // 0 turns compile-time evaluation off
+	    std::string_view value = arg.substr(18);
+	    auto [ptr, ec] = std::from_chars(value.begin(), value.end(), result.interpreter.step_budget);
+	    if(ec != std::errc{} || ptr != value.end()) {
+		return {};
+	    }
+	    constexpr_steps = result.interpreter.step_budget != 0;
+	} else if(arg.starts_with("-fselect=")) {
+	    // if expressions as selects: never, cheap (default) or always when safe
+	    std::string_view mode = arg.substr(9);
+	    if(mode == "never") {
+		result.codegen.selects = select_mode::never;
+	    } else if(mode == "cheap") {
+		result.codegen.selects = select_mode::cheap;
+	    } else if(mode == "always") {
+		result.codegen.selects = select_mode::always;
+	    } else {
+		return {};
+	    }
+	} else if(arg == "-freorder-fields") {
+	    result.reorder_fields = true;
+	} else if(arg == "--profile-generate") {
+	    result.profile_generate = "default_%m.profraw";
+	} else if(arg.starts_with("--profile-generate=")) {
+	    result.profile_generate = arg.substr(19);
+	} else if(arg.starts_with("--profile-use=")) {
+	    result.profile_use = arg.substr(14);
+	} else if(arg == "--order-file" && i + 1 < argc) {
+	    result.order_file = argv[++i];
+	} else if(arg == "--export" && i + 1 < argc) {
+	    result.exports.emplace_back(argv[++i]);
+	} else if(arg == "-j" && i + 1 < argc) {
+	    std::string_view value{argv[++i]};
+	    auto [ptr, ec] = std::from_chars(value.begin(), value.end(), result.jobs);
+	    if(ec != std::errc{} || ptr != value.end() || result.jobs == 0) {
+		return {};
+	    }
+	} else if(result.input.empty() && !arg.starts_with('-')) {
+	    result.input = arg;
+	} else {
+	    return {};
+	}
+    }
+
+    if(result.input.empty()) {
+	return {};
+    }
+    bool profiled = result.profile_generate.has_value() || !result.profile_use.empty();
+    if(result.profile_generate.has_value() && !result.profile_use.empty()) {
+	return {};
+    }
+    // instrumentation and profile use are module passes, the pipeline only runs function simplification
+    if(result.pipelined && profiled) {
+	return {};
+    }
+    // the pipeline has no whole file tree to evaluate calls on, see pipeline.hpp
+    if(result.pipelined && constexpr_steps) {
+	return {};
+    }
+    result.codegen.checked_arithmetic = result.arithmetic.overflow == overflow_mode::trap;
+    return result;
+}
+
 auto main(int argc, char** argv) -> int {
-    if(argc != 2) {
+    auto opts = parse_options(argc, argv);
+    if(!opts.has_value()) {
+	std::cerr << std::format("usage: {} [--pipeline] [-j jobs] [-O0|-O1|-O2|-O3] [-march=cpu|native] [-g|-gline-tables-only] [-fno-ssa] [-ftail-loops] [-fno-bounds-checks] [-freorder-fields] [-fconstexpr-steps=N] [-fselect=never|cheap|always] [-fwrapv|-ftrapv] [-fno-unsigned-wrap] [-ffast-math] [-ffp=flag,...] [--export name]... [--order-file path] [--profile-generate[=pattern]|--profile-use=file.profdata] file.json\n", argv[0]);
 	return -1;
     }
 
-    std::ifstream file{argv[1]};
+    if(!opts->profile_use.empty() && !llvm::sys::fs::exists(opts->profile_use)) {
+	std::cerr << std::format("profile {} does not exist\n", opts->profile_use);
+	return 1;
+    }
+
+    std::ifstream file{opts->input};
     json json = json::parse(file);
 
     llvm::LLVMContext context{};
-    type::registry types{&context};
+    type::interner interner{};
+    type::registry types{&context, &interner};
     special_functions functions{};
 
     default_casts(functions, types);
-    default_binaries(functions);
+    default_binaries(functions, opts->arithmetic);
+    default_vectors(functions, types);
+    default_strings(functions);
 
     types.make_alias("",     type::type_id::void_);
     types.make_alias("bool", type::type_id::bool_);
@@ -67,7 +352,61 @@ auto main(int argc, char** argv) -> int {
     types.make_alias("f32",  type::type_id::fp32);
     types.make_alias("f64",  type::type_id::fp64);
 
-    auto tree = tree_builder{&functions, &types}(json);
+    types.make_alias("f32x4",  type::type_id::f32x4);
+    types.make_alias("f32x8",  type::type_id::f32x8);
+    types.make_alias("i32x4",  type::type_id::i32x4);
+    types.make_alias("i32x8",  type::type_id::i32x8);
+    types.make_alias("u8x16",  type::type_id::u8x16);
+    types.make_alias("mask4",  type::type_id::mask4);
+    types.make_alias("mask8",  type::type_id::mask8);
+    types.make_alias("mask16", type::type_id::mask16);
+    types.make_alias("str",    type::type_id::str);
+
+    std::unique_ptr<llvm::TargetMachine> target_machine = make_target_machine(opts->cpu, !opts->order_file.empty());
+    if(target_machine == nullptr) {
+	return 1;
+    }
+
+    code_generator generator{opts->input, &context, &functions, &types, opts->codegen};
+    llvm::Module& module = generator.get_module();
+
+    // the optimizer's cost models need to know the target up front
+    module.setTargetTriple(target_machine->getTargetTriple().str());
+    module.setDataLayout(target_machine->createDataLayout());
+
+    export_policy exports{opts->exports};
+
+    // structs are named in signatures, so they are known before any function is built
+    auto layouts = tree_builder{&functions, &interner}.declare_structs(json, types, module.getDataLayout(), opts->reorder_fields);
+    if(!layouts.has_value()) {
+	std::cerr << "struct declarations are invalid" << std::endl;
+	return 1;
+    }
+    for(const struct_layout& layout : *layouts) {
+	std::cout << std::format("struct {}: {} bytes, {} as declared\n", layout.name, layout.size, layout.declared_size);
+    }
+
+    if(opts->pipelined) {
+	pipeline stages{&functions, &interner, &generator, &exports, target_machine.get(), opts->level, opts->jobs};
+	bool result = stages.run(json);
+	generator.finish();
+	std::cerr << stages.metrics();
+	if(!result) {
+	    std::cerr << "pipeline failed" << std::endl;
+	    return 1;
+	}
+	if(!opts->order_file.empty() && write_order_file(module, opts->order_file) != 0) {
+	    return 1;
+	}
+	return emit(module, target_machine.get(), opts->input);
+    }
+
+    thread_pool pool{opts->jobs};
+
+    auto tree = tree_builder{&functions, &interner, &pool}(json);
+
+    // nothing unreachable from an export is analyzed or generated
+    std::size_t pruned = exports.prune(std::any_cast<file_node&>(tree));
 
     std::size_t tab{};
     any_tree::const_children_visitor<void> visitor {
@@ -236,6 +575,35 @@ auto main(int argc, char** argv) -> int {
 		any_tree::visit_node(visitor, n.child_at(0));
 		--tab;
 	}),
+	any_tree::make_const_child_visitor<array_literal_node>([&visitor, &tab] (const array_literal_node& n) {
+		tabs(tab);
+		std::cout << "array " << n.payload().type << std::endl;
+		++tab;
+		n.for_each_child([&visitor] (const std::any& n) { any_tree::visit_node(visitor, n); });
+		--tab;
+	}),
+	any_tree::make_const_child_visitor<index_node>([&visitor, &tab] (const index_node& n) {
+		tabs(tab);
+		std::cout << "index" << std::endl;
+		++tab;
+		any_tree::visit_node(visitor, n.child_at(0));
+		any_tree::visit_node(visitor, n.child_at(1));
+		--tab;
+	}),
+	any_tree::make_const_child_visitor<struct_literal_node>([&visitor, &tab] (const struct_literal_node& n) {
+		tabs(tab);
+		std::cout << "struct " << n.payload().name << std::endl;
+		++tab;
+		n.for_each_child([&visitor] (const std::any& n) { any_tree::visit_node(visitor, n); });
+		--tab;
+	}),
+	any_tree::make_const_child_visitor<field_node>([&visitor, &tab] (const field_node& n) {
+		tabs(tab);
+		std::cout << "field " << n.payload().name << std::endl;
+		++tab;
+		any_tree::visit_node(visitor, n.child_at(0));
+		--tab;
+	}),
 	any_tree::make_const_child_visitor<identifier_node>([&tab] (const identifier_node& n) {
 		tabs(tab);
 		std::cout << "identifier " << n.payload() << std::endl;
@@ -273,9 +641,9 @@ auto main(int argc, char** argv) -> int {
 	}),
     };
 
-    std::cout << "building finished" << std::endl;
+    std::cout << "building finished, " << pruned << " unreachable functions dropped" << std::endl;
 
-    semantic_analyzer analyzer{&functions, &types};
+    semantic_analyzer analyzer{&functions, &interner, &pool};
     auto analyzer_result = any_tree::visit_node(analyzer.get_visitor(), tree);
     std::cout << analyzer_result << std::endl;
 
@@ -286,14 +654,18 @@ auto main(int argc, char** argv) -> int {
 	return 1;
     }
 
-    code_generator generator{argv[1], &context, &functions, &types};
+    infer_attributes(std::any_cast<file_node&>(tree), opts->arithmetic.overflow == overflow_mode::trap, opts->codegen.bounds_checks);
+
+    opts->interpreter.arithmetic = opts->arithmetic;
+    std::size_t folded = fold_constants(std::any_cast<file_node&>(tree), opts->interpreter);
+    std::cout << std::format("{} expressions folded\n", folded);
+
     if(llvm::Value* func = any_tree::visit_node(generator.get_visitor(), tree); func == nullptr) {
 	std::cerr << "code generator pass failed" << std::endl;
 	return 1;
     }
+    generator.finish();
 
-    llvm::Module& module = generator.get_module();
-    
     std::cerr << "before optimization" << std::endl;
     module.print(llvm::errs(), nullptr);
 
@@ -304,7 +676,7 @@ auto main(int argc, char** argv) -> int {
     llvm::ModuleAnalysisManager mam;
 
     // Create the new pass manager builder.
-    llvm::PassBuilder pass_builder;
+    llvm::PassBuilder pass_builder{target_machine.get(), llvm::PipelineTuningOptions{}, pgo_options(*opts)};
 
     // Register all the basic analyses with the managers.
     pass_builder.registerModuleAnalyses(mam);
@@ -314,58 +686,18 @@ auto main(int argc, char** argv) -> int {
     pass_builder.crossRegisterProxies(lam, fam, cgam, mam);
 
     // Create the pass manager.
-    llvm::ModulePassManager mpm = pass_builder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O1);
+    llvm::ModulePassManager mpm = opts->level == llvm::OptimizationLevel::O0
+	? pass_builder.buildO0DefaultPipeline(opts->level)
+	: pass_builder.buildPerModuleDefaultPipeline(opts->level);
 
     mpm.run(module, mam);
 
     std::cerr << "after optimization" << std::endl;
     module.print(llvm::errs(), nullptr);
 
-    llvm::InitializeAllTargetInfos();
-    llvm::InitializeAllTargets();
-    llvm::InitializeAllTargetMCs();
-    llvm::InitializeAllAsmParsers();
-    llvm::InitializeAllAsmPrinters();
-
-    std::string target_triple = llvm::sys::getDefaultTargetTriple();
-    module.setTargetTriple(target_triple);
-
-    std::string error;
-    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(target_triple, error);
-    if(!target) {
-	llvm::errs() << error;
-	return 1;
-    }
-
-    const char *cpu = "generic";
-    const char *features = "";
-
-    llvm::TargetOptions opt;
-    //auto rm = std::optional<llvm::Reloc::Model>();
-    llvm::TargetMachine* target_machine = target->createTargetMachine(target_triple, cpu, features, opt, {});
-
-    module.setDataLayout(target_machine->createDataLayout());
-
-    std::string filename = std::string{argv[1]} + ".o";
-    std::error_code error_code;
-    llvm::raw_fd_ostream dest(filename, error_code, llvm::sys::fs::OF_None);
-
-    if (error_code) {
-	llvm::errs() << "Could not open file: " << error_code.message();
-        return 1;
-    }
-    
-    llvm::legacy::PassManager pass;
-    auto filetype = llvm::CodeGenFileType::CGFT_ObjectFile;
-    if(target_machine->addPassesToEmitFile(pass, dest, nullptr, filetype)) {
-	std::cerr << "target machine cannot emit files of this type";
+    if(!opts->order_file.empty() && write_order_file(module, opts->order_file) != 0) {
 	return 1;
     }
 
-    pass.run(module);
-    dest.flush();
-
-    std::cout << std::format("Wrote {}\n", filename);
-
-    return 0;
+    return emit(module, target_machine.get(), opts->input);
 }
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <any>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/PassManager.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Transforms/IPO/FunctionAttrs.h>
+#include <llvm/Transforms/IPO/GlobalDCE.h>
+
+#include <any_tree.hpp>
+
+#include "any_tree/visitor.hpp"
+#include "bounded_queue.hpp"
+#include "pipeline.hpp"
+#include "semantic_analyzer.hpp"
+
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+struct pipeline_item {
+    std::size_t index;
+    std::any function;
+    bool valid;
+};
+
+// busy time and item count of one stage, summed over its workers
+class stage_counter {
+    std::atomic<std::int64_t> _busy{};
+    std::atomic<std::size_t> _items{};
+    clock::time_point _start{clock::now()};
+    std::atomic<std::int64_t> _wall{};
+
+public:
+    template<typename F>
+    void measure(F&& work) {
+	auto start = clock::now();
+	work();
+	_busy += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+	++_items;
+    }
+
+    void finish() {
+	_wall = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - _start).count();
+    }
+
+    auto metrics(std::string name, std::size_t workers) const -> stage_metrics {
+	return {std::move(name), _items.load(), workers, static_cast<double>(_busy.load()) / 1e9, static_cast<double>(_wall.load()) / 1e9, 0, 0, 0.0};
+    }
+};
+
+// the last worker of a stage to finish closes the queue of the next one
+class stage_workers {
+    std::atomic<std::size_t> _remaining;
+    std::vector<std::jthread> _threads{};
+
+public:
+    template<typename F>
+    stage_workers(std::size_t workers, stage_counter& counter, bounded_queue<pipeline_item>& output, F work)
+	: _remaining{workers}
+    {
+	_threads.reserve(workers);
+	for(std::size_t i = 0; i < workers; ++i) {
+	    _threads.emplace_back([this, &counter, &output, work] {
+		work();
+		if(--_remaining == 0) {
+		    counter.finish();
+		    output.close();
+		}
+	    });
+	}
+    }
+};
+
+// a function is only started once the one size places before it is
+// lowered, so no more than size functions are anywhere between building and
+// lowering, the reorder buffer in front of lowering included. the head is
+// always inside the window, a slow one stops the stages behind it instead
+// of letting later functions pile up
+class lowering_window {
+    std::mutex _lock{};
+    std::condition_variable _moved{};
+    std::size_t _lowered{};
+    std::size_t _size;
+
+public:
+    explicit lowering_window(std::size_t size) : _size{std::max<std::size_t>(size, 1)} {}
+
+    void enter(std::size_t index) {
+	std::unique_lock guard{_lock};
+	_moved.wait(guard, [this, index] { return index < _lowered + _size; });
+    }
+
+    void advance(std::size_t lowered) {
+	{
+	    std::scoped_lock guard{_lock};
+	    _lowered = lowered;
+	}
+	_moved.notify_all();
+    }
+};
+
+} // namespace
+
+
+auto pipeline::run(const json& object) -> bool {
+    const json& functions = object["functions"];
+    std::size_t count = functions.size();
+
+    tree_builder builder{_special, _types};
+
+    // callee signatures are the only dependency between function bodies
+    std::vector<function_info> signatures{};
+    signatures.reserve(count);
+    // malformed signatures fail the run like malformed bodies do
+    try {
+	for(const json& function : functions) {
+	    signatures.push_back(builder.signature(function));
+	}
+    } catch(...) {
+	return false;
+    }
+    _exports->mark(signatures);
+
+    const semantic_analyzer::function_table table = semantic_analyzer{_special, _types}.collect_functions(signatures);
+
+    bounded_queue<pipeline_item> built{_queue_capacity};
+    bounded_queue<pipeline_item> analyzed{_queue_capacity};
+
+    stage_counter build_counter{};
+    stage_counter analyze_counter{};
+    stage_counter lower_counter{};
+
+    std::atomic<std::size_t> next_function{};
+    lowering_window window{_queue_capacity};
+
+    // stages are started from the back so that each one only outlives its consumers' threads
+    stage_workers analyze_stage{_workers, analyze_counter, analyzed, [this, &built, &analyzed, &analyze_counter, &table] {
+	semantic_analyzer analyzer{_special, _types};
+	for(auto item = built.pop(); item.has_value(); item = built.pop()) {
+	    if(item->valid) {
+		analyze_counter.measure([&] { item->valid = type::valid(analyzer.analyze_function(item->function, table)); });
+	    }
+	    analyzed.push(std::move(*item));
+	}
+    }};
+
+    stage_workers build_stage{_workers, build_counter, built, [&builder, &functions, &built, &build_counter, &next_function, &window, count] {
+	for(std::size_t index = next_function++; index < count; index = next_function++) {
+	    window.enter(index);
+	    pipeline_item item{index, {}, true};
+	    build_counter.measure([&] {
+		try {
+		    item.function = builder.build_function(functions[index]);
+		} catch(...) {
+		    item.valid = false;
+		}
+	    });
+	    built.push(std::move(item));
+	}
+    }};
+
+    // lowering stays on this thread, it owns the LLVMContext, prototypes let
+    // calls to functions that are still in flight be lowered
+    for(const function_info& info : signatures) {
+	_generator->declare(info);
+    }
+
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+
+    llvm::PassBuilder pass_builder{_target};
+    pass_builder.registerModuleAnalyses(mam);
+    pass_builder.registerCGSCCAnalyses(cgam);
+    pass_builder.registerFunctionAnalyses(fam);
+    pass_builder.registerLoopAnalyses(lam);
+    pass_builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+    std::optional<llvm::FunctionPassManager> fpm{};
+    if(_level != llvm::OptimizationLevel::O0) {
+	fpm = pass_builder.buildFunctionSimplificationPipeline(_level, llvm::ThinOrFullLTOPhase::None);
+    }
+
+    // functions are lowered in source order, later ones wait here if they
+    // overtake, the window keeps it to _queue_capacity entries
+    std::map<std::size_t, pipeline_item> pending{};
+    std::size_t next_lowered{};
+    bool result = true;
+
+    for(auto item = analyzed.pop(); item.has_value(); item = analyzed.pop()) {
+	pending.emplace(item->index, std::move(*item));
+
+	for(auto iter = pending.begin(); iter != pending.end() && iter->first == next_lowered; iter = pending.erase(iter), ++next_lowered) {
+	    if(!iter->second.valid) {
+		result = false;
+		continue;
+	    }
+
+	    // an exception leaving here would skip draining analyzed, and
+	    // the analyze workers blocked on pushing into it are joined below
+	    lower_counter.measure([&] {
+		try {
+		    auto* func = llvm::dyn_cast_or_null<llvm::Function>(any_tree::visit_node(_generator->get_visitor(), iter->second.function));
+		    if(func == nullptr) {
+			result = false;
+			return;
+		    }
+		    if(fpm.has_value()) {
+			fpm->run(*func, fam);
+		    }
+		} catch(...) {
+		    result = false;
+		}
+	    });
+	}
+	window.advance(next_lowered);
+    }
+    lower_counter.finish();
+
+    // what the tree based flow does over the whole file before lowering, done
+    // on the module once everything is lowered: attribute inference over the
+    // call graph and dropping functions no export reaches
+    if(result && next_lowered == count) {
+	llvm::ModulePassManager mpm{};
+	mpm.addPass(llvm::createModuleToPostOrderCGSCCPassAdaptor(llvm::PostOrderFunctionAttrsPass{}));
+	mpm.addPass(llvm::ReversePostOrderFunctionAttrsPass{});
+	mpm.addPass(llvm::GlobalDCEPass{});
+	mpm.run(_generator->get_module(), mam);
+    }
+
+    _metrics = {
+	build_counter.metrics("build", _workers),
+	analyze_counter.metrics("analyze", _workers),
+	lower_counter.metrics("lower", 1),
+    };
+    _metrics[1].queue_capacity = built.capacity();
+    _metrics[1].max_queue_depth = built.max_depth();
+    _metrics[1].average_queue_depth = built.average_depth();
+    _metrics[2].queue_capacity = analyzed.capacity();
+    _metrics[2].max_queue_depth = analyzed.max_depth();
+    _metrics[2].average_queue_depth = analyzed.average_depth();
+
+    return result && next_lowered == count;
+}
+
+auto operator<<(std::ostream& out, const std::vector<stage_metrics>& metrics) -> std::ostream& {
+    out << std::format("{:<10}{:>8}{:>9}{:>10}{:>10}{:>12}{:>10}{:>10}\n", "stage", "items", "workers", "busy s", "wall s", "items/s", "queue max", "queue avg");
+    for(const stage_metrics& stage : metrics) {
+	out << std::format("{:<10}{:>8}{:>9}{:>10.3f}{:>10.3f}{:>12.1f}{:>4}/{:<5}{:>10.2f}\n",
+		stage.name, stage.items, stage.workers, stage.busy_seconds, stage.wall_seconds,
+		stage.throughput(), stage.max_queue_depth, stage.queue_capacity, stage.average_queue_depth);
+    }
+    return out;
+}
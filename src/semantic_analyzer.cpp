@@ -1,6 +1,9 @@
 #include <iostream>
 #include <ranges>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <numeric>
 #include <tuple>
 
 #include <any_tree.hpp>
@@ -9,25 +12,96 @@
 #include "functions.hpp"
 #include "semantic_analyzer.hpp"
 #include "tree.hpp"
-#include "type/type.hpp"
+#include "type/interner.hpp"
 #include "type/type_id.hpp"
 
 
 auto semantic_analyzer::file(const visitor& visitor, file_node& node) -> type::type_id {
-    bool result = std::ranges::all_of(
-	    node.children(), 
-	    type::valid, 
-	    [&visitor] (std::any& node) { return any_tree::visit_node(visitor, node); }
+    // first phase: every signature is known before any body is checked,
+    // so functions may call each other regardless of their order
+    function_table functions = collect_functions(node);
+    _functions = &functions;
+
+    if(_pool == nullptr) {
+	bool result = std::ranges::all_of(
+		node.children(), 
+		type::valid, 
+		[&visitor] (std::any& node) { return any_tree::visit_node(visitor, node); }
+	);
+	_functions = nullptr;
+	return result ? type::type_id::good_file : type::type_id::undetermined;
+    }
+
+    // second phase: bodies are independent, each task gets its own analyzer and scopes
+    std::atomic<bool> result{true};
+    _pool->parallel_for(
+	    node.children_size(),
+	    [this, &functions] {
+		auto worker = std::make_unique<semantic_analyzer>(_special, _types);
+		worker->_functions = &functions;
+		return worker;
+	    },
+	    [&node, &result] (std::unique_ptr<semantic_analyzer>& worker, std::size_t index) {
+		if(!type::valid(any_tree::visit_node(worker->get_visitor(), node.children()[index]))) {
+		    result.store(false, std::memory_order_relaxed);
+		}
+	    }
     );
-    return result ? type::type_id::good_file : type::type_id::undetermined;
+    _functions = nullptr;
+
+    return result.load() ? type::type_id::good_file : type::type_id::undetermined;
+}
+
+auto semantic_analyzer::collect_functions(file_node& node) -> function_table {
+    function_table functions{};
+    for(std::size_t index = 0; index < node.children_size(); ++index) {
+	const function_info& info = function_at(node, index).payload();
+	functions.add(info.name, {_types->id(info.params_type, info.return_type), index});
+    }
+    return functions;
+}
+
+auto semantic_analyzer::collect_functions(std::span<const function_info> signatures) -> function_table {
+    function_table functions{};
+    for(std::size_t index = 0; index < signatures.size(); ++index) {
+	functions.add(signatures[index].name, {_types->id(signatures[index].params_type, signatures[index].return_type), index});
+    }
+    return functions;
+}
+
+auto semantic_analyzer::analyze_function(std::any& node, const function_table& functions) -> type::type_id {
+    _functions = &functions;
+    type::type_id result = any_tree::visit_node(_visitor, node);
+    _functions = nullptr;
+    return result;
+}
+
+auto semantic_analyzer::lookup(const std::string& name) const noexcept -> type::type_id {
+    if(auto local = _scope.get(name); local.has_value()) {
+	return *local;
+    }
+    if(auto function = lookup_function(name); function.has_value()) {
+	return function->type;
+    }
+    return type::type_id::undetermined;
+}
+
+auto semantic_analyzer::lookup_function(const std::string& name) const noexcept -> std::optional<function_entry> {
+    if(_functions == nullptr) {
+	return {};
+    }
+    return _functions->get(name);
 }
 
 auto semantic_analyzer::function(const visitor& visitor, function_node& node) -> type::type_id {
     // get function type
     type::type_id func_type = _types->id(node.payload().params_type, node.payload().return_type);
 
-    // push function and parameters to scope
-    _scope.add(node.payload().name, func_type);
+    if(auto entry = lookup_function(node.payload().name); entry.has_value()) {
+	node.payload().index = entry->index;
+    }
+
+    // push parameters to scope, function itself is already in the function table
     scope_pusher pusher{&_scope, func_type};
 
     auto param_name = node.payload().params.begin();
@@ -46,8 +120,9 @@ auto semantic_analyzer::function(const visitor& visitor, function_node& node) ->
 }
 
 auto semantic_analyzer::return_statement(const visitor& visitor, return_statement_node& node) -> type::type_id {
-    type::type_id stmt_type =  any_tree::visit_node(visitor, node.child_at(0));
     type::type_id func_return = _types->get_function(_scope.function())->return_type();
+    expect(node.child_at(0), func_return);
+    type::type_id stmt_type =  any_tree::visit_node(visitor, node.child_at(0));
     
     if(stmt_type == func_return) {
 	return stmt_type;
@@ -71,13 +146,30 @@ auto semantic_analyzer::let_statement(const visitor& visitor, let_statement_node
     return result ? type::type_id::good_stmt : type::type_id::undetermined;
 }
 
-auto var_def_with_expr(const semantic_analyzer::visitor& visitor, var_def_node& node, special_functions* special) -> type::type_id {
+auto assignable(const std::any& node) -> bool {
+    if(const auto* element = std::any_cast<index_node>(&node); element != nullptr) {
+	return assignable(element->child_at(0));
+    }
+    if(const auto* member = std::any_cast<field_node>(&node); member != nullptr) {
+	return assignable(member->child_at(0));
+    }
+    return std::any_cast<identifier_node>(&node) != nullptr;
+}
+
+auto var_def_with_expr(const semantic_analyzer::visitor& visitor, var_def_node& node, const special_functions* special) -> type::type_id {
     type::type_id expr_type = any_tree::visit_node(visitor, node.child_at(0));
 
     if(!type::valid(expr_type)) {
 	return type::type_id::undetermined;
     }
 
+    // "x: f32 = 1.0" takes the literal as f32 instead of going through its default type
+    bool declared = node.payload().type != type::type_id::unset;
+    if(declared && type::is_literal(expr_type) && special->cast(expr_type).get(node.payload().type).has_value()) {
+	node.child_at(0) = insert_implicit_cast(std::move(node.child_at(0)), expr_type, node.payload().type);
+	return node.payload().type;
+    }
+
     if(auto default_t = type::default_type(expr_type); type::is_literal(expr_type)) {
 	node.child_at(0) = insert_implicit_cast(std::move(node.child_at(0)), expr_type, default_t);
 	expr_type = default_t;
@@ -113,6 +205,7 @@ auto semantic_analyzer::var_def(const visitor& visitor, var_def_node& node) -> t
     if(node.children().empty()) {
 	type = var_def_without_expr(node);
     } else {
+	expect(node.child_at(0), node.payload().type);
 	type = var_def_with_expr(visitor, node, _special);
     }
 
@@ -126,9 +219,18 @@ auto semantic_analyzer::var_def(const visitor& visitor, var_def_node& node) -> t
 
 auto semantic_analyzer::binary_expr(const visitor& visitor, binary_expr_node& node) -> type::type_id {
     type::type_id lhs_type = any_tree::visit_node(visitor, node.child_at(0));
+
+    if(node.payload().oper == "=") {
+	expect(node.child_at(1), lhs_type);
+    }
     type::type_id rhs_type = any_tree::visit_node(visitor, node.child_at(1));
 
     if(node.payload().oper == "=") {
+	// elements of temporaries are not assignable, the store would be lost
+	if(!assignable(node.child_at(0))) {
+	    return type::type_id::undetermined;
+	}
+
 	if(lhs_type == rhs_type) {
 	    return lhs_type;
 	}
@@ -141,7 +243,7 @@ auto semantic_analyzer::binary_expr(const visitor& visitor, binary_expr_node& no
 	return type::type_id::undetermined;
     }
 
-    auto binary_op = _special->binary(node.payload().oper);
+    const auto& binary_op = _special->binary(node.payload().oper);
 
     if(binary_op.empty()) {
 	return type::type_id::undetermined;
@@ -374,43 +476,226 @@ auto semantic_analyzer::block(const visitor& visitor, block_node& node) -> type:
 }
 
 auto semantic_analyzer::call(const visitor& visitor, call_node& node) -> type::type_id {
-    type::type_id func_type_id = _scope.get(node.payload().callee).value_or(type::type_id::undetermined);
-    const type::function_type* func_type = _types->get_function(func_type_id);
+    // locals shadow functions, but cannot be called
+    if(_scope.get(node.payload().callee).has_value()) {
+	return type::type_id::undetermined;
+    }
+
+    auto callee = lookup_function(node.payload().callee);
+    if(!callee.has_value()) {
+	return builtin_call(visitor, node);
+    }
+
+    const type::descriptor* func_type = _types->get_function(callee->type);
     if(func_type == nullptr) {
 	return type::type_id::undetermined;
     }
+    node.payload().callee_index = callee->index;
+
+    if(node.children().size() != func_type->params().size() || !arguments(visitor, node, func_type->params(), 0)) {
+	return type::type_id::undetermined;
+    }
 
-    if(node.children().size() != func_type->params().size()) {
+    return node.payload().type = func_type->return_type();
+}
+
+auto semantic_analyzer::builtin_call(const visitor& visitor, call_node& node) -> type::type_id {
+    const builtin_function& builtin = _special->builtin(node.payload().callee);
+    if(builtin.empty() || node.children().empty()) {
 	return type::type_id::undetermined;
     }
 
-    auto expr_iter = node.children().begin();
-    auto param_iter = func_type->params().begin();
-    for(; expr_iter != node.children().end(); ++expr_iter, ++param_iter) {
-	type::type_id expr_type = any_tree::visit_node(visitor, *expr_iter);
+    // the first argument picks the overload, it is only cast when it is a literal
+    type::type_id first = any_tree::visit_node(visitor, node.children().front());
+    const builtin_function::overload* overload = type::is_literal(first) ? literal_overload(builtin, first) : builtin.get(first);
+    if(overload == nullptr || node.children().size() != overload->params.size()) {
+	return type::type_id::undetermined;
+    }
+    node.payload().builtin = overload;
+
+    if(type::is_literal(first)) {
+	node.children().front() = insert_implicit_cast(std::move(node.children().front()), first, overload->params.front());
+    }
+
+    if(!arguments(visitor, node, overload->params, 1)) {
+	return type::type_id::undetermined;
+    }
+
+    return node.payload().type = overload->return_type;
+}
+
+// the only overload the literal casts to, e.g. splat8(0.0) has just f32, or
+// else the one for the literal's default type, e.g. splat4(1) picks i32 over f32
+auto semantic_analyzer::literal_overload(const builtin_function& builtin, type::type_id literal) const -> const builtin_function::overload* {
+    const builtin_function::overload* castable = nullptr;
+    std::size_t matches = 0;
+    for(const auto& [param, overload] : builtin.overloads()) {
+	if(_special->cast(literal).get(param).has_value()) {
+	    castable = &overload;
+	    ++matches;
+	}
+    }
+
+    if(matches == 1) {
+	return castable;
+    }
+    if(const builtin_function::overload* fallback = builtin.get(type::default_type(literal)); fallback != nullptr && _special->cast(literal).get(type::default_type(literal)).has_value()) {
+	return fallback;
+    }
+    return nullptr;
+}
+
+auto semantic_analyzer::arguments(const visitor& visitor, call_node& node, std::span<const type::type_id> params, std::size_t from) -> bool {
+    for(std::size_t i = from; i < params.size(); ++i) {
+	if(!coerce(visitor, node.children()[i], params[i])) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+auto semantic_analyzer::coerce(const visitor& visitor, std::any& node, type::type_id type) -> bool {
+    expect(node, type);
+    type::type_id expr_type = any_tree::visit_node(visitor, node);
+
+    if(!type::valid(expr_type)) {
+	return false;
+    }
+
+    if(expr_type == type) {
+	return true;
+    }
+
+    if(!_special->cast(expr_type).get(type).has_value()) {
+	return false;
+    }
+
+    node = insert_implicit_cast(std::move(node), expr_type, type);
+    return true;
+}
+
+auto semantic_analyzer::array_literal(const visitor& visitor, array_literal_node& node) -> type::type_id {
+    std::vector<type::type_id> types{};
+    types.reserve(node.children_size());
+    for(std::any& child : node.children()) {
+	types.push_back(any_tree::visit_node(visitor, child));
+    }
+
+    if(types.empty() || !std::ranges::all_of(types, type::valid)) {
+	return type::type_id::undetermined;
+    }
 
-	if(!type::valid(expr_type)) {
+    type::type_id element{};
+    if(const type::descriptor* expected = _types->get_array(node.payload().type); expected != nullptr) {
+	if(expected->length() != types.size()) {
 	    return type::type_id::undetermined;
 	}
+	element = expected->element();
+    } else {
+	// first typed element decides, literals alone get their default type
+	auto typed = std::ranges::find_if_not(types, type::is_literal);
+	element = typed != types.end() ? *typed : type::default_type(types.front());
+    }
 
-	if(expr_type == *param_iter) {
+    for(std::size_t i = 0; i < types.size(); ++i) {
+	if(types[i] == element) {
 	    continue;
 	}
 
-	auto cast = _special->cast(expr_type).get(*param_iter);
+	if(!_special->cast(types[i]).get(element).has_value()) {
+	    return type::type_id::undetermined;
+	}
+	node.children()[i] = insert_implicit_cast(std::move(node.children()[i]), types[i], element);
+    }
+
+    return node.payload().type = _types->id(element, types.size());
+}
+
+auto semantic_analyzer::index(const visitor& visitor, index_node& node) -> type::type_id {
+    type::type_id array_t = any_tree::visit_node(visitor, node.child_at(0));
+    type::type_id index_t = any_tree::visit_node(visitor, node.child_at(1));
 
-	if(!cast.has_value()) {
+    const type::descriptor* array = _types->get_array(array_t);
+    if(array == nullptr || !type::valid(index_t)) {
+	return type::type_id::undetermined;
+    }
+
+    // constant indexes are checked here and never need a check at run time
+    if(const auto* literal = std::any_cast<integer_literal_node>(&node.child_at(1)); literal != nullptr) {
+	if(literal->payload().value >= array->length()) {
 	    return type::type_id::undetermined;
 	}
+	node.child_at(1) = insert_implicit_cast(std::move(node.child_at(1)), index_t, type::type_id::u64);
+	index_t = type::type_id::u64;
+    }
 
-	*expr_iter = insert_implicit_cast(std::move(*expr_iter), expr_type, *param_iter);
+    if(!type::is_integer(index_t)) {
+	return type::type_id::undetermined;
     }
 
-    return node.payload().type = func_type->return_type();
+    node.payload() = {array_t, array->element(), array->length(), type::is_signed(index_t)};
+    return array->element();
+}
+
+auto semantic_analyzer::struct_literal(const visitor& visitor, struct_literal_node& node) -> type::type_id {
+    type::type_id struct_t = _types->id(node.payload().name);
+    const type::descriptor* desc = _types->get_struct(struct_t);
+    if(desc == nullptr || node.children_size() != desc->members().size()) {
+	return type::type_id::undetermined;
+    }
+
+    // every field exactly once, in any order
+    std::vector<bool> seen(desc->members().size());
+    node.payload().members.resize(node.children_size());
+
+    for(std::size_t i = 0; i < node.children_size(); ++i) {
+	auto field = std::ranges::find(desc->fields(), node.payload().fields[i]);
+	if(field == desc->fields().end()) {
+	    return type::type_id::undetermined;
+	}
+
+	auto index = static_cast<std::size_t>(field - desc->fields().begin());
+	if(seen[index]) {
+	    return type::type_id::undetermined;
+	}
+	seen[index] = true;
+	node.payload().members[i] = index;
+
+	if(!coerce(visitor, node.children()[i], desc->members()[index])) {
+	    return type::type_id::undetermined;
+	}
+    }
+
+    return node.payload().type = struct_t;
+}
+
+auto semantic_analyzer::field(const visitor& visitor, field_node& node) -> type::type_id {
+    type::type_id struct_t = any_tree::visit_node(visitor, node.child_at(0));
+
+    const type::descriptor* desc = _types->get_struct(struct_t);
+    if(desc == nullptr) {
+	return type::type_id::undetermined;
+    }
+
+    auto field = std::ranges::find(desc->fields(), node.payload().name);
+    if(field == desc->fields().end()) {
+	return type::type_id::undetermined;
+    }
+
+    node.payload().type = struct_t;
+    node.payload().index = static_cast<std::size_t>(field - desc->fields().begin());
+    node.payload().member = desc->members()[node.payload().index];
+    return node.payload().member;
+}
+
+void semantic_analyzer::expect(std::any& node, type::type_id type) const noexcept {
+    if(auto* literal = std::any_cast<array_literal_node>(&node); literal != nullptr && _types->get_array(type) != nullptr) {
+	literal->payload().type = type;
+    }
 }
 
 auto semantic_analyzer::identifier(identifier_node& node) -> type::type_id {
-    return _scope.get(node.payload()).value_or(type::type_id::undetermined);
+    return lookup(node.payload());
 }
 
 auto semantic_analyzer::integer_literal(integer_literal_node& node) -> type::type_id {
@@ -426,17 +711,17 @@ auto semantic_analyzer::char_literal(char_literal_node& node) -> type::type_id {
 }
 
 auto semantic_analyzer::string_literal(string_literal_node& node) -> type::type_id {
-    // not impolemented yet
-    return type::type_id::undetermined;
+    return node.payload().type = type::type_id::str;
 }
 
 auto semantic_analyzer::bool_literal(bool_literal_node& node) -> type::type_id {
     return node.payload().type = type::type_id::bool_;
 }
 
-semantic_analyzer::semantic_analyzer(special_functions* special, type::registry* types)
+semantic_analyzer::semantic_analyzer(const special_functions* special, type::interner* types, thread_pool* pool)
     : _special{special}
     , _types{types}
+    , _pool{pool}
 {
     _visitor = {
 	any_tree::make_child_visitor<file_node>            ([this] (file_node& node)             { return file(_visitor, node); }),
@@ -451,6 +736,10 @@ semantic_analyzer::semantic_analyzer(special_functions* special, type::registry*
 	any_tree::make_child_visitor<loop_node>            ([this] (loop_node& node)             { return loop_stmt(_visitor, node); }),
 	any_tree::make_child_visitor<block_node>           ([this] (block_node& node)            { return block(_visitor, node); }),
 	any_tree::make_child_visitor<call_node>            ([this] (call_node& node)             { return call(_visitor, node); }),
+	any_tree::make_child_visitor<array_literal_node>   ([this] (array_literal_node& node)    { return array_literal(_visitor, node); }),
+	any_tree::make_child_visitor<index_node>           ([this] (index_node& node)            { return index(_visitor, node); }),
+	any_tree::make_child_visitor<struct_literal_node>  ([this] (struct_literal_node& node)   { return struct_literal(_visitor, node); }),
+	any_tree::make_child_visitor<field_node>           ([this] (field_node& node)            { return field(_visitor, node); }),
 	any_tree::make_child_visitor<identifier_node>      ([this] (identifier_node& node)       { return identifier(node); }),
 	any_tree::make_child_visitor<integer_literal_node> (integer_literal ),
 	any_tree::make_child_visitor<floating_literal_node>(floating_literal),
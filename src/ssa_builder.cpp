@@ -0,0 +1,120 @@
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Constants.h>
+
+#include "ssa_builder.hpp"
+
+
+auto ssa_builder::make_variable(std::string name, llvm::Type* type, llvm::AllocaInst* slot) -> variable* {
+    return &_variables.emplace_back(variable{std::move(name), type, slot});
+}
+
+void ssa_builder::write(const variable* var, const llvm::BasicBlock* block, llvm::Value* value) {
+    _definitions[{var, block}] = value;
+}
+
+auto ssa_builder::read(const variable* var, llvm::BasicBlock* block) -> llvm::Value* {
+    if(auto iter = _definitions.find({var, block}); iter != _definitions.end() && iter->second != nullptr) {
+	return iter->second;
+    }
+    return read_recursive(var, block);
+}
+
+auto ssa_builder::read_recursive(const variable* var, llvm::BasicBlock* block) -> llvm::Value* {
+    llvm::Value* value{};
+
+    if(_unsealed.contains(block)) {
+	// operands are added once every predecessor is known
+	llvm::PHINode* phi = make_phi(var, block);
+	_incomplete[block].emplace_back(var, phi);
+	value = phi;
+    } else if(llvm::BasicBlock* pred = block->getSinglePredecessor(); pred != nullptr) {
+	value = read(var, pred);
+    } else if(llvm::pred_empty(block)) {
+	// read before any definition, same as loading an uninitialized alloca
+	value = llvm::UndefValue::get(var->type);
+    } else {
+	// the phi is recorded first so that cycles through this block end on it
+	llvm::PHINode* phi = make_phi(var, block);
+	write(var, block, phi);
+	value = add_phi_operands(var, phi);
+    }
+
+    write(var, block, value);
+    return value;
+}
+
+auto ssa_builder::add_phi_operands(const variable* var, llvm::PHINode* phi) -> llvm::Value* {
+    // one entry per edge, a block branching here twice is listed twice
+    for(llvm::BasicBlock* pred : llvm::predecessors(phi->getParent())) {
+	phi->addIncoming(read(var, pred), pred);
+    }
+    return try_remove_trivial_phi(phi);
+}
+
+auto ssa_builder::try_remove_trivial_phi(llvm::PHINode* phi) -> llvm::Value* {
+    llvm::Value* same{};
+    for(llvm::Value* operand : phi->incoming_values()) {
+	if(operand == same || operand == phi) {
+	    continue;
+	}
+	if(same != nullptr) {
+	    return phi;
+	}
+	same = operand;
+    }
+
+    if(same == nullptr) {
+	same = llvm::UndefValue::get(phi->getType());
+    }
+
+    std::vector<llvm::WeakTrackingVH> users{};
+    for(llvm::User* user : phi->users()) {
+	if(user != phi && llvm::isa<llvm::PHINode>(user)) {
+	    users.emplace_back(user);
+	}
+    }
+
+    phi->replaceAllUsesWith(same);
+    phi->eraseFromParent();
+
+    // removing this phi may have made the ones using it trivial, phis that
+    // are still incomplete or being filled are left to whoever fills them
+    for(llvm::Value* user : users) {
+	auto* user_phi = llvm::dyn_cast_or_null<llvm::PHINode>(user);
+	if(user_phi != nullptr && user_phi->getNumIncomingValues() == llvm::pred_size(user_phi->getParent())) {
+	    try_remove_trivial_phi(user_phi);
+	}
+    }
+
+    return same;
+}
+
+void ssa_builder::seal(llvm::BasicBlock* block) {
+    _unsealed.erase(block);
+
+    auto iter = _incomplete.find(block);
+    if(iter == _incomplete.end()) {
+	return;
+    }
+
+    auto phis = std::move(iter->second);
+    _incomplete.erase(iter);
+
+    for(auto [var, phi] : phis) {
+	add_phi_operands(var, phi);
+    }
+}
+
+void ssa_builder::clear() {
+    _definitions.clear();
+    _unsealed.clear();
+    _incomplete.clear();
+    _variables.clear();
+}
+
+auto ssa_builder::make_phi(const variable* var, llvm::BasicBlock* block) -> llvm::PHINode* {
+    if(block->empty()) {
+	return llvm::PHINode::Create(var->type, 0, var->name, block);
+    }
+    return llvm::PHINode::Create(var->type, 0, var->name, &block->front());
+}
@@ -0,0 +1,61 @@
+#include <mutex>
+#include <utility>
+
+#include "thread_pool.hpp"
+
+
+namespace {
+
+// the pool whose worker is running on this thread, if any
+thread_local const thread_pool* current_pool = nullptr;
+
+} // namespace
+
+
+thread_pool::thread_pool(std::size_t threads) {
+    threads = std::max<std::size_t>(threads, 1);
+
+    _workers.reserve(threads);
+    for(std::size_t i = 0; i < threads; ++i) {
+	_workers.emplace_back([this] { work(); });
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+	std::scoped_lock guard{_lock};
+	_stopping = true;
+    }
+    _ready.notify_all();
+}
+
+void thread_pool::submit(std::function<void()> task) {
+    {
+	std::scoped_lock guard{_lock};
+	_tasks.push_back(std::move(task));
+    }
+    _ready.notify_one();
+}
+
+auto thread_pool::on_worker() const noexcept -> bool {
+    return current_pool == this;
+}
+
+void thread_pool::work() {
+    current_pool = this;
+    while(true) {
+	std::function<void()> task{};
+	{
+	    std::unique_lock guard{_lock};
+	    _ready.wait(guard, [this] { return _stopping || !_tasks.empty(); });
+
+	    if(_tasks.empty()) {
+		return;
+	    }
+
+	    task = std::move(_tasks.front());
+	    _tasks.pop_front();
+	}
+	task();
+    }
+}
@@ -2,66 +2,118 @@
 #include <iostream>
 #include <iterator>
 #include <unordered_map>
+#include <unordered_set>
+#include <format>
 #include <functional>
 #include <vector>
 #include <optional>
+#include <stdexcept>
+#include <string_view>
 
 #include "any_tree/visitor.hpp"
 #include "tree.hpp"
+#include "type/layout.hpp"
 #include "type/type_id.hpp"
 
 
 auto tree_builder::file(const json& object) -> file_node {
     file_node node{};
+    const json& functions = object["functions"];
 
-    std::ranges::transform(object["functions"], std::back_inserter(node.children()), function_hander());
+    if(_pool == nullptr) {
+	std::ranges::transform(functions, std::back_inserter(node.children()), function_hander());
+	return node;
+    }
+
+    // functions are built independently, each one into its own slot to keep the order
+    node.children().resize(functions.size());
+    _pool->parallel_for(functions.size(), [this, &functions, &node] (std::size_t index) {
+	node.children()[index] = function(functions[index]);
+    });
 
     return node;
 }
 
 auto tree_builder::function(const json& object) -> function_node {
-    function_node node{};
+    function_node node{signature(object)};
+
+    node.child_at(0) = block(object["funcBody"]);
+
+    return node;
+}
+
+auto tree_builder::signature(const json& object) -> function_info {
+    function_info info{};
+
+    info.name = object["funcName"].template get<std::string>();
+    info.position = position(object);
+    info.return_type = parse_type(object["funcReturn"].template get<std::string>());
 
-    node.payload().name = object["funcName"].template get<std::string>();
-    node.payload().return_type = _types->id(object["funcReturn"].template get<std::string>());
+    if(auto iter = object.find("funcExported"); iter != object.end() && !iter->is_null()) {
+	info.exported = iter->template get<bool>();
+    }
+
+    // either a switch for everything or a list of flag names
+    if(auto iter = object.find("funcFastMath"); iter != object.end() && !iter->is_null()) {
+	if(iter->is_boolean()) {
+	    info.fast_math = iter->template get<bool>() ? fp_flags::fast : fp_flags::none;
+	} else {
+	    fp_flags flags = fp_flags::none;
+	    for(const json& name : *iter) {
+		// a misspelled flag would silently leave the function strict
+		auto flag = parse_fp_flag(name.template get<std::string>());
+		if(!flag.has_value()) {
+		    throw std::invalid_argument{std::format("{}: unknown funcFastMath flag {}", info.name, name.template get<std::string>())};
+		}
+		flags |= *flag;
+	    }
+	    info.fast_math = flags;
+	}
+    }
+
+    if(auto iter = object.find("funcHot"); iter != object.end() && !iter->is_null() && iter->template get<bool>()) {
+	info.hot = true;
+    } else if(auto iter = object.find("funcCold"); iter != object.end() && !iter->is_null() && iter->template get<bool>()) {
+	info.hot = false;
+    }
 
-    node.payload().params.reserve(object["funcParams"].size());
-    node.payload().params_type.reserve(object["funcParams"].size());
+    info.params.reserve(object["funcParams"].size());
+    info.params_type.reserve(object["funcParams"].size());
 
     std::ranges::transform(
 	    object["funcParams"], 
-	    std::back_inserter(node.payload().params), 
+	    std::back_inserter(info.params), 
 	    [] (const json& object) { 
 		return object["argName"].template get<std::string>(); 
 	    }
     );
     std::ranges::transform(
 	    object["funcParams"], 
-	    std::back_inserter(node.payload().params_type), 
+	    std::back_inserter(info.params_type), 
 	    [this] (const json& object) { 
-		return _types->id(object["argType"].template get<std::string>()); 
+		return parse_type(object["argType"].template get<std::string>()); 
 	    }
     );
 
-    node.child_at(0) = block(object["funcBody"]);
-
-    return node;
+    return info;
 }
 
 auto tree_builder::stmt(const json& object) -> std::any {
-    static std::unordered_map<std::string, std::function<std::any(const json&)>> handlers{
-	{"IgnoreResultStmt",       expr_hander()},
-	{"ReturnStmt",             return_stmt_hander()},
-	{"VariableDefinitionStmt", let_stmt_hander()},
-	{"IfStmt",                 if_handler()},
-	{"LoopStmt",               loop_hander()},
+    // handlers are only read after initialization, so concurrent builds are fine,
+    // the builder is passed in since the table outlives the first one to use it
+    static const std::unordered_map<std::string, std::function<std::any(tree_builder&, const json&)>> handlers{
+	{"IgnoreResultStmt",       &tree_builder::expr},
+	{"ReturnStmt",             &tree_builder::return_stmt},
+	{"VariableDefinitionStmt", &tree_builder::let_stmt},
+	{"IfStmt",                 &tree_builder::if_stmt},
+	{"LoopStmt",               &tree_builder::loop},
     };
 
-    return handlers[object["tag"]](object["contents"]);
+    return handlers.at(object["tag"].template get<std::string>())(*this, object["contents"]);
 }
 
 auto tree_builder::return_stmt(const json& object) -> return_statement_node {
-    return_statement_node node{}; 
+    return_statement_node node{position(object)};
     node.child_at(0) = expr(object); 
     return node;
 }
@@ -78,11 +130,12 @@ auto tree_builder::var_def(const json& object) -> var_def_node {
     var_def_node node{};
 
     node.payload().name = object["varName"].template get<std::string>();
+    node.payload().position = position(object);
 
     if(const json& type = object["varType"]; type.is_null()) {
 	node.payload().type = type::type_id::unset;
     } else {
-	node.payload().type = _types->id(type.template get<std::string>());
+	node.payload().type = parse_type(type.template get<std::string>());
     }
 
     if(const json& value = object["varValue"]; !value.is_null()) {
@@ -92,7 +145,7 @@ auto tree_builder::var_def(const json& object) -> var_def_node {
     return node;
 }
 
-auto tree_builder::operator_resolution(std::span<std::any> primaries, std::span<std::string> ops) -> std::any {
+auto tree_builder::operator_resolution(std::span<std::any> primaries, std::span<std::string> ops, source_position position) -> std::any {
     if(ops.empty()) {
 	return primaries.front();
     }
@@ -101,8 +154,9 @@ auto tree_builder::operator_resolution(std::span<std::any> primaries, std::span<
     auto op_pos = op_iter - ops.begin();
 
     binary_expr_node node{*op_iter};
-    node.children()[0] = operator_resolution(primaries.first(op_pos + 1), ops.first(op_pos));
-    node.children()[1] = operator_resolution(primaries.subspan(op_pos + 1), ops.subspan(op_pos + 1));
+    node.payload().position = position;
+    node.children()[0] = operator_resolution(primaries.first(op_pos + 1), ops.first(op_pos), position);
+    node.children()[1] = operator_resolution(primaries.subspan(op_pos + 1), ops.subspan(op_pos + 1), position);
 
     return node;
 }
@@ -127,25 +181,52 @@ auto tree_builder::expr(const json& object) -> std::any {
 	primaries.emplace_back(primary(rhs["rhsOperand"]));
     });
 
-    return operator_resolution(std::span{primaries}, std::span{ops});
+    return operator_resolution(std::span{primaries}, std::span{ops}, position(object));
 }
 
 auto tree_builder::primary(const json& object) -> std::any {
     // should replace with constexpr std::flat_map once c++23 is out
-    static std::unordered_map<std::string, std::function<std::any(const json&)>> handlers{
-	{"PrimaryId",      [] (const json& object) { return identifier_node{object.template get<std::string>()}; }},
-	{"PrimaryParens",  expr_hander()},
-	{"PrimaryCall",    call_hander()},
-	{"PrimaryLiteral", literal},
-	{"PrimaryIf",      if_expr_handler()},
+    static const std::unordered_map<std::string, std::function<std::any(tree_builder&, const json&)>> handlers{
+	{"PrimaryId",      [] (tree_builder&, const json& object) { return identifier_node{object.template get<std::string>()}; }},
+	{"PrimaryParens",  &tree_builder::expr},
+	{"PrimaryCall",    &tree_builder::call},
+	{"PrimaryLiteral", [] (tree_builder&, const json& object) { return literal(object); }},
+	{"PrimaryIf",      &tree_builder::if_expr},
+	{"PrimaryArray",   &tree_builder::array},
+	{"PrimaryIndex",   &tree_builder::index},
+	{"PrimaryStruct",  &tree_builder::struct_literal},
+	{"PrimaryField",   &tree_builder::field},
     };
 
     const std::string& type = object["tag"].template get<std::string>();
-    return handlers[type](object["contents"]);
+    return handlers.at(type)(*this, object["contents"]);
+}
+
+auto tree_builder::branch_hint(const json& object) -> std::optional<bool> {
+    auto flag = [&object] (const char* name) {
+	auto iter = object.find(name);
+	return iter != object.end() && !iter->is_null() && iter->template get<bool>();
+    };
+
+    if(flag("likely")) {
+	return true;
+    }
+    if(flag("unlikely")) {
+	return false;
+    }
+    return {};
+}
+
+auto tree_builder::position(const json& object) -> source_position {
+    auto iter = object.find("pos");
+    if(iter == object.end() || iter->is_null()) {
+	return {};
+    }
+    return {iter->value("line", 0U), iter->value("column", 0U)};
 }
 
 auto tree_builder::if_stmt(const json& object) -> std::any {
-    if_info info{!object["ifScopeVar"].is_null()};
+    if_info info{!object["ifScopeVar"].is_null(), branch_hint(object), position(object)};
 
     std::any let{};
     if(info.has_let) {
@@ -177,7 +258,8 @@ auto tree_builder::if_expr(const json& object) -> if_else_expr_node {
 	throw int{};
     }
 
-    if_else_expr_node node{!object["ifScopeVar"].is_null()};
+    if_expr_info info{{!object["ifScopeVar"].is_null(), branch_hint(object), position(object)}};
+    if_else_expr_node node{info};
 
     if(node.payload().has_let) {
 	node.child_at(0) = let_stmt(object["ifScopeVar"]);
@@ -191,6 +273,7 @@ auto tree_builder::if_expr(const json& object) -> if_else_expr_node {
 
 auto tree_builder::call(const json& object) -> call_node {
     call_node node{object["callable"].template get<std::string>()};
+    node.payload().position = position(object);
 
     std::ranges::transform(object["callParams"], std::back_inserter(node.children()), expr_hander());
 
@@ -214,12 +297,191 @@ auto tree_builder::loop(const json& object) -> loop_node {
 
     node.child_at(3) = block(object["loopBody"]);
 
+    // "loopUnroll" is either a switch or an unroll count
+    if(auto iter = object.find("loopUnroll"); iter != object.end() && !iter->is_null()) {
+	if(iter->is_boolean()) {
+	    node.payload().unroll = iter->template get<bool>();
+	} else {
+	    node.payload().unroll = true;
+	    node.payload().unroll_count = iter->template get<unsigned>();
+	}
+    }
+
+    if(auto iter = object.find("loopVectorize"); iter != object.end() && !iter->is_null()) {
+	node.payload().vectorize = iter->template get<bool>();
+    }
+
+    if(auto iter = object.find("loopVectorizeWidth"); iter != object.end() && !iter->is_null()) {
+	node.payload().vectorize = true;
+	node.payload().vectorize_width = iter->template get<unsigned>();
+    }
+
+    node.payload().likely = branch_hint(object);
+    node.payload().position = position(object);
+
+    if(auto iter = object.find("expectedTripCount"); iter != object.end() && !iter->is_null()) {
+	node.payload().expected_trip_count = iter->template get<unsigned>();
+    }
+
+    return node;
+}
+
+auto tree_builder::array(const json& object) -> array_literal_node {
+    array_literal_node node{type::type_id::unset};
+
+    node.children().reserve(object.size());
+    std::ranges::transform(object, std::back_inserter(node.children()), expr_hander());
+
     return node;
 }
 
+auto tree_builder::index(const json& object) -> index_node {
+    index_node node{};
+
+    node.child_at(0) = primary(object["indexed"]);
+    node.child_at(1) = expr(object["index"]);
+
+    return node;
+}
+
+auto tree_builder::struct_literal(const json& object) -> struct_literal_node {
+    struct_literal_node node{object["structName"].template get<std::string>()};
+
+    node.payload().fields.reserve(object["structFields"].size());
+    node.children().reserve(object["structFields"].size());
+
+    for(const json& field : object["structFields"]) {
+	node.payload().fields.emplace_back(field["fieldName"].template get<std::string>());
+	node.children().emplace_back(expr(field["fieldValue"]));
+    }
+
+    return node;
+}
+
+auto tree_builder::field(const json& object) -> field_node {
+    field_node node{object["field"].template get<std::string>()};
+
+    node.child_at(0) = primary(object["accessed"]);
+
+    return node;
+}
+
+auto tree_builder::declare_structs(const json& object, type::registry& types, const llvm::DataLayout& data_layout, bool reorder) -> std::optional<std::vector<struct_layout>> {
+    std::vector<struct_layout> layouts{};
+
+    auto structs = object.find("structs");
+    if(structs == object.end() || structs->is_null()) {
+	return layouts;
+    }
+
+    struct member {
+	std::string name;
+	type::type_id type;
+	bool hot;
+	std::size_t align;
+    };
+
+    // in order, a struct may hold any struct declared before it
+    for(const json& definition : *structs) {
+	const std::string name = definition["structName"].template get<std::string>();
+	// also catches a struct named like a primitive
+	if(type::valid(parse_type(name))) {
+	    std::cerr << std::format("struct {} is already declared\n", name);
+	    return {};
+	}
+
+	std::vector<member> members{};
+	std::vector<type::type_id> declared{};
+	std::unordered_set<std::string> field_names{};
+
+	for(const json& field : definition["structFields"]) {
+	    const std::string field_name = field["fieldName"].template get<std::string>();
+	    if(!field_names.insert(field_name).second) {
+		std::cerr << std::format("struct {}: field {} is declared twice\n", name, field_name);
+		return {};
+	    }
+
+	    const std::string type_name = field["fieldType"].template get<std::string>();
+	    type::type_id type = parse_type(type_name);
+	    if(!type::valid(type)) {
+		std::cerr << std::format("struct {}: field {} has unknown type {}\n", name, field_name, type_name);
+		return {};
+	    }
+
+	    bool hot = false;
+	    if(auto iter = field.find("fieldHot"); iter != field.end() && !iter->is_null()) {
+		hot = iter->template get<bool>();
+	    }
+
+	    auto layout = type::layout_of(types, data_layout, type);
+	    members.push_back({field_name, type, hot, layout.has_value() ? layout->align : 1});
+	    declared.push_back(type);
+	}
+
+	bool reorder_fields = reorder;
+	if(auto iter = definition.find("structReorder"); iter != definition.end() && !iter->is_null()) {
+	    reorder_fields = iter->template get<bool>();
+	}
+
+	// largest alignment first leaves no holes between fields, the
+	// hot ones go in front so they share the first cache line
+	if(reorder_fields) {
+	    std::ranges::stable_sort(members, [] (const member& lhs, const member& rhs) {
+		if(lhs.hot != rhs.hot) {
+		    return lhs.hot;
+		}
+		return lhs.align > rhs.align;
+	    });
+	}
+
+	type::descriptor::fields_type fields{};
+	fields.reserve(members.size());
+	std::ranges::transform(members, std::back_inserter(fields), [] (const member& field) { return std::pair{field.name, field.type}; });
+
+	type::type_id type = _types->make_struct(name, fields);
+
+	auto declared_layout = type::layout_of(types, data_layout, declared);
+	auto layout = type::layout_of(types, data_layout, type);
+	if(!type::valid(type) || !declared_layout.has_value() || !layout.has_value()) {
+	    std::cerr << std::format("struct {} has no layout\n", name);
+	    return {};
+	}
+
+	layouts.push_back({name, type, declared_layout->size, layout->size});
+    }
+
+    return layouts;
+}
+
+auto tree_builder::parse_type(const std::string& name) -> type::type_id {
+    if(name.size() < 2 || name.front() != '[' || name.back() != ']') {
+	return _types->id(name);
+    }
+
+    // the last ';' is the outermost one, "[[f32; 4]; 4]" is 4 arrays of 4 floats
+    std::size_t separator = name.rfind(';');
+    if(separator == std::string::npos) {
+	return type::type_id::undetermined;
+    }
+
+    auto trim = [] (std::string_view view) {
+	view.remove_prefix(std::min(view.find_first_not_of(' '), view.size()));
+	view.remove_suffix(view.size() - std::min(view.find_last_not_of(' ') + 1, view.size()));
+	return std::string{view};
+    };
+
+    type::type_id element = parse_type(trim(std::string_view{name}.substr(1, separator - 1)));
+    std::string length = trim(std::string_view{name}.substr(separator + 1, name.size() - separator - 2));
+
+    if(!type::valid(element) || length.empty() || !std::ranges::all_of(length, [] (char digit) { return '0' <= digit && digit <= '9'; })) {
+	return type::type_id::undetermined;
+    }
+    return _types->id(element, std::stoull(length));
+}
+
 auto tree_builder::literal(const json& object) -> std::any {
     // should replace with constexpr std::flat_map once c++23 is out
-    static std::unordered_map<std::string, std::function<std::any(const json&)>> handlers{
+    static const std::unordered_map<std::string, std::function<std::any(const json&)>> handlers{
 	{"IntegerLiteral", [] (const json& object) { return integer_literal_node {object.template get<std::uint64_t>()}; }},
 	{"FloatLiteral",   [] (const json& object) { return floating_literal_node{object.template get<double>()};        }},
 	{"CharLiteral",    [] (const json& object) { return char_literal_node    {object.template get<char>()};          }},
@@ -227,7 +489,7 @@ auto tree_builder::literal(const json& object) -> std::any {
 	{"BoolLiteral",    [] (const json& object) { return bool_literal_node    {object.template get<bool>()};          }},
     };
 
-    return handlers[object["tag"]](object["contents"]);
+    return handlers.at(object["tag"].template get<std::string>())(object["contents"]);
 }
 
 auto tree_builder::block(const json& object) -> block_node {
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <functional>
+
+#include "type/interner.hpp"
+#include "type/type_id.hpp"
+
+
+type::sharded_index::sharded_index() {
+    for(shard& owner : _shards) {
+	owner.current.store(owner.tables.emplace_back(std::make_unique<table>(initial_capacity)).get(), std::memory_order_release);
+    }
+}
+
+auto type::sharded_index::grow(shard& owner) -> table* {
+    const table& old = *owner.current.load(std::memory_order_relaxed);
+    auto bigger = std::make_unique<table>((old.mask + 1) * 2);
+
+    for(std::size_t index = 0; index <= old.mask; ++index) {
+	std::uint64_t value = old.slots[index].load(std::memory_order_relaxed);
+	if(value != 0) {
+	    place(*bigger, value >> 32U, static_cast<std::uint32_t>(tag(value) - 1));
+	}
+    }
+
+    table* current = owner.tables.emplace_back(std::move(bigger)).get();
+    owner.current.store(current, std::memory_order_release);
+    return current;
+}
+
+
+namespace {
+
+auto hash_kind(type::kind kind, std::uint64_t hash) noexcept -> std::uint64_t {
+    return hash_mix(hash ^ hash_seed_0, static_cast<std::uint64_t>(kind) ^ hash_seed_1);
+}
+
+auto hash_name(std::string_view name) noexcept -> std::uint64_t {
+    return hash_mix(std::hash<std::string_view>{}(name) ^ hash_seed_2, hash_seed_0);
+}
+
+} // namespace
+
+
+type::interner::interner() {
+    for(type_id tid = type_id::void_; tid != type_id::primitive_bound; ++tid) {
+	_types.slot(static_cast<std::size_t>(tid)) = descriptor{kind::primitive};
+    }
+}
+
+auto type::interner::allocate(descriptor&& desc) -> std::uint32_t {
+    std::uint64_t tid = _next_type.fetch_add(1, std::memory_order_relaxed);
+    _types.slot(tid) = std::move(desc);
+
+    // ids are published in order, the slot is written before the release
+    // store makes it visible to describe(), a writer that got a later id
+    // waits for the ones before it
+    for(std::uint64_t seen = _published_types.load(std::memory_order_acquire); seen != tid; seen = _published_types.load(std::memory_order_acquire)) {
+	_published_types.wait(seen, std::memory_order_acquire);
+    }
+    _published_types.store(tid + 1, std::memory_order_release);
+    _published_types.notify_all();
+    return static_cast<std::uint32_t>(tid);
+}
+
+auto type::interner::id(std::string_view name) const noexcept -> type_id {
+    auto equal = [this, name] (std::uint32_t handle) { return _names[handle].name == name; };
+
+    if(auto found = _name_index.find(hash_name(name), equal); found.has_value()) {
+	return _names[*found].tid.load(std::memory_order_acquire);
+    }
+    return {};
+}
+
+auto type::interner::id(std::span<const type_id> members) noexcept -> type_id {
+    std::uint64_t hash = hash_kind(kind::anon_structure, span_hash<type_id>{}(members));
+    auto equal = [this, members] (std::uint32_t handle) {
+	const descriptor& desc = _types[handle];
+	return desc.get_kind() == kind::anon_structure && std::ranges::equal(desc.members(), members);
+    };
+
+    if(auto found = _type_index.find(hash, equal); found.has_value()) {
+	return type_id{*found};
+    }
+
+    return type_id{_type_index.insert(hash, equal, [this, members] {
+	return allocate(descriptor{kind::anon_structure, {members.begin(), members.end()}});
+    })};
+}
+
+auto type::interner::id(std::span<const type_id> params, type_id ret) noexcept -> type_id {
+    std::uint64_t hash = hash_kind(kind::function, hash_mix(span_hash<type_id>{}(params), static_cast<std::uint64_t>(ret) ^ hash_seed_2));
+    auto equal = [this, params, ret] (std::uint32_t handle) {
+	const descriptor& desc = _types[handle];
+	return desc.get_kind() == kind::function && desc.return_type() == ret && std::ranges::equal(desc.params(), params);
+    };
+
+    if(auto found = _type_index.find(hash, equal); found.has_value()) {
+	return type_id{*found};
+    }
+
+    return type_id{_type_index.insert(hash, equal, [this, params, ret] {
+	return allocate(descriptor{kind::function, {params.begin(), params.end()}, ret});
+    })};
+}
+
+auto type::interner::id(type_id elements, std::size_t size) noexcept -> type_id {
+    std::uint64_t hash = hash_kind(kind::array, pair_hash<type_id, std::size_t>{}({elements, size}));
+    auto equal = [this, elements, size] (std::uint32_t handle) {
+	const descriptor& desc = _types[handle];
+	return desc.get_kind() == kind::array && desc.element() == elements && desc.length() == size;
+    };
+
+    if(auto found = _type_index.find(hash, equal); found.has_value()) {
+	return type_id{*found};
+    }
+
+    return type_id{_type_index.insert(hash, equal, [this, elements, size] {
+	return allocate(descriptor{kind::array, {}, elements, size});
+    })};
+}
+
+auto type::interner::describe(type_id tid) const noexcept -> const descriptor* {
+    auto index = static_cast<std::uint64_t>(tid);
+    if(index >= _published_types.load(std::memory_order_acquire)) {
+	return nullptr;
+    }
+
+    const descriptor& desc = _types[index];
+    if(desc.get_kind() == kind::none) {
+	return nullptr;
+    }
+    return &desc;
+}
+
+auto type::interner::get_struct(type_id tid) const noexcept -> const descriptor* {
+    const descriptor* desc = describe(tid);
+    return desc != nullptr && desc->get_kind() == kind::structure ? desc : nullptr;
+}
+
+auto type::interner::get_anon_struct(type_id tid) const noexcept -> const descriptor* {
+    const descriptor* desc = describe(tid);
+    return desc != nullptr && desc->get_kind() == kind::anon_structure ? desc : nullptr;
+}
+
+auto type::interner::get_function(type_id tid) const noexcept -> const descriptor* {
+    const descriptor* desc = describe(tid);
+    return desc != nullptr && desc->get_kind() == kind::function ? desc : nullptr;
+}
+
+auto type::interner::get_array(type_id tid) const noexcept -> const descriptor* {
+    const descriptor* desc = describe(tid);
+    return desc != nullptr && desc->get_kind() == kind::array ? desc : nullptr;
+}
+
+auto type::interner::make_struct(const std::string& name, const descriptor::fields_type& fields) noexcept -> type_id {
+    // structs are nominal, every definition gets its own id
+    type_id sid{allocate(descriptor{name, fields})};
+    make_alias(name, sid);
+    return sid;
+}
+
+void type::interner::make_alias(const std::string& alias, type_id tid) noexcept {
+    std::uint64_t hash = hash_name(alias);
+    auto equal = [this, &alias] (std::uint32_t handle) { return _names[handle].name == alias; };
+
+    std::uint32_t handle = _name_index.insert(hash, equal, [this, &alias, tid] {
+	std::uint32_t fresh = _next_name.fetch_add(1, std::memory_order_relaxed);
+	name_record& record = _names.slot(fresh);
+	record.name = alias;
+	record.tid.store(tid, std::memory_order_relaxed);
+	return fresh;
+    });
+
+    _names[handle].tid.store(tid, std::memory_order_release);
+}
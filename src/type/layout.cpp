@@ -0,0 +1,25 @@
+#include <llvm/IR/DerivedTypes.h>
+
+#include "type/layout.hpp"
+#include "type/registry.hpp"
+#include "type/type.hpp"
+#include "type/type_id.hpp"
+
+
+auto type::layout_of(const registry& types, const llvm::DataLayout& data_layout, type_id tid) noexcept -> std::optional<layout> {
+    llvm::Type* lowered = *types.get(tid).value_or(type{});
+    if(lowered == nullptr || !lowered->isSized()) {
+	return {};
+    }
+
+    if(auto* struct_t = llvm::dyn_cast<llvm::StructType>(lowered); struct_t != nullptr) {
+	const llvm::StructLayout* struct_layout = data_layout.getStructLayout(struct_t);
+	return layout{struct_layout->getSizeInBytes(), struct_layout->getAlignment().value()};
+    }
+    return layout{data_layout.getTypeAllocSize(lowered).getFixedValue(), data_layout.getABITypeAlign(lowered).value()};
+}
+
+auto type::layout_of(registry& types, const llvm::DataLayout& data_layout, std::span<const type_id> members) noexcept -> std::optional<layout> {
+    // an anonymous struct of the members is laid out like a named one with the same fields
+    return layout_of(types, data_layout, types.id(members));
+}
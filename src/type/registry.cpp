@@ -1,7 +1,11 @@
+#include <algorithm>
 #include <memory>
 #include <utility>
 
+#include <llvm/IR/DerivedTypes.h>
+
 #include "type/registry.hpp"
+#include "type/interner.hpp"
 #include "type/type_id.hpp"
 #include "type/type.hpp"
 #include "type/array_type.hpp"
@@ -10,114 +14,37 @@
 #include "type/function_type.hpp"
 
 
-auto type::registry::id(const std::string& name) const noexcept -> type_id {
-    if(auto iter = _names.find(name); iter != _names.end()) {
-	return iter->second;
-    }
-    return {};
-}
-
-auto type::registry::id(const std::vector<type_id>& members) noexcept -> type_id {
-    if(auto iter = _anon_struct_ids.find(members); iter != _anon_struct_ids.end()) {
-	return iter->second;
-    }
-
-    std::vector<llvm::Type*> members_llvm(members.size());
-    std::ranges::transform(members, members_llvm.begin(), [this] (auto type) { return *get(type).value_or(::type::type{}); });
-
-    llvm::StructType* anon_struct_t = llvm::StructType::get(*_context, members_llvm);
-
-    type_id tid{next_id()};
-
-    _anon_struct_ids[members] = tid;
-    _anon_structs.try_emplace(tid, anon_struct_t, members);
-
-    return tid;
-}
-
-auto type::registry::id(const std::vector<type_id>& params, type_id ret) noexcept -> type_id {
-    auto func_pair = std::make_pair(params, ret);
-    if(auto iter = _function_ids.find(func_pair); iter != _function_ids.end()) {
-	return iter->second;
-    }
-
-    std::vector<llvm::Type*> params_llvm(params.size());
-    std::ranges::transform(params, params_llvm.begin(), [this] (auto type) { return *get(type).value_or(::type::type{}); });
-
-    llvm::FunctionType* function_t = llvm::FunctionType::get(*get(ret).value_or(type{}), params_llvm, false);
-
-    type_id fid{next_id()};
-
-    _function_ids[func_pair] = fid;
-    _functions.try_emplace(fid, function_t, params, ret);
-
-    return fid;
-}
-
-auto type::registry::id(type_id elements, std::size_t size) noexcept -> type_id {
-    auto arr_pair = std::make_pair(elements, size);
-    if(auto iter = _array_ids.find(arr_pair); iter != _array_ids.end()) {
-	return iter->second;
-    }
-
-    llvm::ArrayType* array_t = llvm::ArrayType::get(*get(elements).value_or(type{}), size);
-
-    type_id aid{next_id()};
-
-    _array_ids[arr_pair] = aid;
-    _arrays.try_emplace(aid, array_t, elements, size);
-
-    return aid;
-}
-
 auto type::registry::get(type_id tid) const noexcept -> std::optional<type> {
-    if(auto iter = _primitives.find(tid); iter != _primitives.end()) {
-	return iter->second;
+    if(const entry* found = find(tid, kind::none); found != nullptr) {
+	return type{found->type};
     }
-
-    if (const struct_type *struct_t = get_struct(tid); struct_t != nullptr) {
-        return type{*struct_t};
-    }
-
-    if (const anon_struct_type *anon_struct_t = get_anon_struct(tid); anon_struct_t != nullptr) {
-        return type{*anon_struct_t};
-    }
-
-    if (const function_type *function_t = get_function(tid); function_t != nullptr) {
-        return type{*function_t};
-    }
-
-    if (const array_type *array_t = get_array(tid); array_t != nullptr) {
-        return type{*array_t};
-    }
-
     return {};
 }
 
 auto type::registry::get_struct(type_id tid) const noexcept -> const struct_type* {
-    if(auto iter = _structs.find(tid); iter != _structs.end()) {
-	return &iter->second;
+    if(const entry* found = find(tid, kind::structure); found != nullptr) {
+	return &_structs[found->index];
     }
     return nullptr;
 }
 
 auto type::registry::get_anon_struct(type_id tid) const noexcept -> const anon_struct_type* {
-    if(auto iter = _anon_structs.find(tid); iter != _anon_structs.end()) {
-	return &iter->second;
+    if(const entry* found = find(tid, kind::anon_structure); found != nullptr) {
+	return &_anon_structs[found->index];
     }
     return nullptr;
 }
 
 auto type::registry::get_function(type_id tid) const noexcept -> const function_type* {
-    if(auto iter = _functions.find(tid); iter != _functions.end()) {
-	return &iter->second;
+    if(const entry* found = find(tid, kind::function); found != nullptr) {
+	return &_functions[found->index];
     }
     return nullptr;
 }
 
 auto type::registry::get_array(type_id tid) const noexcept -> const array_type* {
-    if(auto iter = _arrays.find(tid); iter != _arrays.end()) {
-	return &iter->second;
+    if(const entry* found = find(tid, kind::array); found != nullptr) {
+	return &_arrays[found->index];
     }
     return nullptr;
 }
@@ -139,25 +66,14 @@ auto type::registry::get_array(const std::string& name) const noexcept -> const
 }
 
 auto type::registry::make_struct(const std::string& name, const struct_type::members_type& members) noexcept -> const struct_type& {
-    std::vector<llvm::Type*> members_llvm(members.size());
-    std::ranges::transform(members, members_llvm.begin(), [this] (auto type) { return *get(type.second).value_or(::type::type{}); });
-
-    llvm::StructType* struct_t = llvm::StructType::get(*_context, members_llvm);
-    struct_t->setName(name);
-
-    type_id sid{next_id()};
-
-    _names[name] = sid;
-    _structs.try_emplace(sid, struct_t, members);
-
-    return _structs.find(sid)->second;
+    return *get_struct(_interner->make_struct(name, members));
 }
 
-auto type::registry::make_anon_struct(const std::vector<type_id>& members) noexcept -> const anon_struct_type& {
+auto type::registry::make_anon_struct(std::span<const type_id> members) noexcept -> const anon_struct_type& {
     return *get_anon_struct(id(members));
 }
 
-auto type::registry::make_function(const std::vector<type_id>& params, type_id ret) noexcept -> const function_type& {
+auto type::registry::make_function(std::span<const type_id> params, type_id ret) noexcept -> const function_type& {
     return *get_function(id(params, ret));
 }
 
@@ -165,19 +81,114 @@ auto type::registry::make_array(type_id elements, std::size_t size) noexcept ->
     return *get_array(id(elements, size));
 }
 
+auto type::registry::find(type_id tid, kind expected) const noexcept -> const entry* {
+    const entry* found = materialize(tid);
+    if(found == nullptr || (expected != kind::none && found->tag != expected)) {
+	return nullptr;
+    }
+    return found;
+}
+
+auto type::registry::lower_all(std::span<const type_id> tids) const noexcept -> std::vector<llvm::Type*> {
+    std::vector<llvm::Type*> lowered(tids.size());
+    std::ranges::transform(tids, lowered.begin(), [this] (auto tid) { return *get(tid).value_or(::type::type{}); });
+    return lowered;
+}
+
+auto type::registry::materialize(type_id tid) const noexcept -> const entry* {
+    auto index = static_cast<std::size_t>(tid);
+    if(index < _entries.size() && _entries[index].tag != kind::none) {
+	return &_entries[index];
+    }
+
+    const descriptor* desc = _interner->describe(tid);
+    if(desc == nullptr || desc->get_kind() == kind::primitive) {
+	return nullptr;
+    }
+
+    // lowering members may materialize other types, so the entry is written last
+    entry created{desc->get_kind()};
+    switch(desc->get_kind()) {
+	case kind::structure: {
+	    llvm::StructType* struct_t = llvm::StructType::create(*_context, lower_all(desc->members()), desc->name());
+
+	    struct_type::members_type members{};
+	    members.reserve(desc->members().size());
+	    for(std::size_t i = 0; i < desc->members().size(); ++i) {
+		members.emplace_back(desc->fields()[i], desc->members()[i]);
+	    }
+
+	    created.type = struct_t;
+	    created.index = static_cast<std::uint32_t>(_structs.size());
+	    _structs.emplace_back(struct_t, std::move(members));
+	    break;
+	}
+	case kind::anon_structure: {
+	    llvm::StructType* anon_struct_t = llvm::StructType::get(*_context, lower_all(desc->members()));
+
+	    created.type = anon_struct_t;
+	    created.index = static_cast<std::uint32_t>(_anon_structs.size());
+	    _anon_structs.emplace_back(anon_struct_t, std::vector<type_id>{desc->members().begin(), desc->members().end()});
+	    break;
+	}
+	case kind::function: {
+	    llvm::Type* return_t = *get(desc->return_type()).value_or(type{});
+	    llvm::FunctionType* function_t = llvm::FunctionType::get(return_t, lower_all(desc->params()), false);
+
+	    created.type = function_t;
+	    created.index = static_cast<std::uint32_t>(_functions.size());
+	    _functions.emplace_back(function_t, std::vector<type_id>{desc->params().begin(), desc->params().end()}, desc->return_type());
+	    break;
+	}
+	case kind::array: {
+	    llvm::ArrayType* array_t = llvm::ArrayType::get(*get(desc->element()).value_or(type{}), desc->length());
+
+	    created.type = array_t;
+	    created.index = static_cast<std::uint32_t>(_arrays.size());
+	    _arrays.emplace_back(array_t, desc->element(), desc->length());
+	    break;
+	}
+	default:
+	    return nullptr;
+    }
+
+    if(index >= _entries.size()) {
+	_entries.resize(index + 1);
+    }
+    _entries[index] = created;
+    return &_entries[index];
+}
+
 void type::registry::make_primitives() noexcept {
-    _primitives.try_emplace(type_id::undetermined);
-    _primitives.try_emplace(type_id::void_, llvm::Type::getVoidTy  (*_context));
-    _primitives.try_emplace(type_id::bool_, llvm::Type::getInt1Ty  (*_context));
-    _primitives.try_emplace(type_id::char_, llvm::Type::getInt8Ty  (*_context));
-    _primitives.try_emplace(type_id::u8,    llvm::Type::getInt8Ty  (*_context));
-    _primitives.try_emplace(type_id::u16,   llvm::Type::getInt16Ty (*_context));
-    _primitives.try_emplace(type_id::u32,   llvm::Type::getInt32Ty (*_context));
-    _primitives.try_emplace(type_id::u64,   llvm::Type::getInt64Ty (*_context));
-    _primitives.try_emplace(type_id::i8,    llvm::Type::getInt8Ty  (*_context));
-    _primitives.try_emplace(type_id::i16,   llvm::Type::getInt16Ty (*_context));
-    _primitives.try_emplace(type_id::i32,   llvm::Type::getInt32Ty (*_context));
-    _primitives.try_emplace(type_id::i64,   llvm::Type::getInt64Ty (*_context));
-    _primitives.try_emplace(type_id::fp32,  llvm::Type::getFloatTy (*_context));
-    _primitives.try_emplace(type_id::fp64,  llvm::Type::getDoubleTy(*_context));
+    // ids below primitive_bound are fixed, the rest come from the interner
+    _entries.resize(static_cast<std::size_t>(type_id::primitive_bound) + 1);
+
+    auto add_primitive = [this] (type_id tid, llvm::Type* type) {
+	_entries[static_cast<std::size_t>(tid)] = {kind::primitive, type, 0};
+    };
+    add_primitive(type_id::undetermined, nullptr);
+    add_primitive(type_id::void_, llvm::Type::getVoidTy  (*_context));
+    add_primitive(type_id::bool_, llvm::Type::getInt1Ty  (*_context));
+    add_primitive(type_id::char_, llvm::Type::getInt8Ty  (*_context));
+    add_primitive(type_id::u8,    llvm::Type::getInt8Ty  (*_context));
+    add_primitive(type_id::u16,   llvm::Type::getInt16Ty (*_context));
+    add_primitive(type_id::u32,   llvm::Type::getInt32Ty (*_context));
+    add_primitive(type_id::u64,   llvm::Type::getInt64Ty (*_context));
+    add_primitive(type_id::i8,    llvm::Type::getInt8Ty  (*_context));
+    add_primitive(type_id::i16,   llvm::Type::getInt16Ty (*_context));
+    add_primitive(type_id::i32,   llvm::Type::getInt32Ty (*_context));
+    add_primitive(type_id::i64,   llvm::Type::getInt64Ty (*_context));
+    add_primitive(type_id::fp32,  llvm::Type::getFloatTy (*_context));
+    add_primitive(type_id::fp64,  llvm::Type::getDoubleTy(*_context));
+
+    add_primitive(type_id::f32x4,  llvm::FixedVectorType::get(llvm::Type::getFloatTy(*_context), 4));
+    add_primitive(type_id::f32x8,  llvm::FixedVectorType::get(llvm::Type::getFloatTy(*_context), 8));
+    add_primitive(type_id::i32x4,  llvm::FixedVectorType::get(llvm::Type::getInt32Ty(*_context), 4));
+    add_primitive(type_id::i32x8,  llvm::FixedVectorType::get(llvm::Type::getInt32Ty(*_context), 8));
+    add_primitive(type_id::u8x16,  llvm::FixedVectorType::get(llvm::Type::getInt8Ty (*_context), 16));
+    add_primitive(type_id::mask4,  llvm::FixedVectorType::get(llvm::Type::getInt1Ty (*_context), 4));
+    add_primitive(type_id::mask8,  llvm::FixedVectorType::get(llvm::Type::getInt1Ty (*_context), 8));
+    add_primitive(type_id::mask16, llvm::FixedVectorType::get(llvm::Type::getInt1Ty (*_context), 16));
+
+    add_primitive(type_id::str, llvm::StructType::get(llvm::PointerType::getUnqual(*_context), llvm::Type::getInt64Ty(*_context)));
 }